@@ -0,0 +1,286 @@
+#include "capture.hpp"
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+const size_t WIDTH = components::Display::cols;
+const size_t HEIGHT = components::Display::rows;
+
+// Row bytes in display order: column 0 is the top bit of the first byte.
+std::array<uint8_t, 8> rowBytes(uint64_t row) {
+  std::array<uint8_t, 8> bytes;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(row >> (56 - 8 * i));
+  }
+  return bytes;
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> t;
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[n] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void putBE32(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+void putChunk(std::vector<uint8_t> &out, const char *type,
+              const std::vector<uint8_t> &data) {
+  putBE32(out, data.size());
+  const size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  putBE32(out, crc32(out.data() + start, out.size() - start));
+}
+
+// 1-bit grayscale PNG, lit pixels white. The image is tiny, so the zlib
+// stream uses a single stored (uncompressed) block.
+std::vector<uint8_t> encodePng(const components::Display::Frame &frame) {
+  std::vector<uint8_t> scanlines;
+  for (uint64_t row : frame) {
+    scanlines.push_back(0);  // filter: none
+    const auto bytes = rowBytes(row);
+    scanlines.insert(scanlines.end(), bytes.begin(), bytes.end());
+  }
+
+  uint32_t a = 1, b = 0;
+  for (uint8_t byte : scanlines) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+
+  std::vector<uint8_t> zlib = {0x78, 0x01, 0x01};
+  const uint16_t len = scanlines.size();
+  zlib.push_back(len & 0xFF);
+  zlib.push_back(len >> 8);
+  zlib.push_back(~len & 0xFF);
+  zlib.push_back((~len >> 8) & 0xFF);
+  zlib.insert(zlib.end(), scanlines.begin(), scanlines.end());
+  putBE32(zlib, (b << 16) | a);
+
+  std::vector<uint8_t> header;
+  putBE32(header, WIDTH);
+  putBE32(header, HEIGHT);
+  header.insert(header.end(), {1, 0, 0, 0, 0});
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  putChunk(png, "IHDR", header);
+  putChunk(png, "IDAT", zlib);
+  putChunk(png, "IEND", {});
+  return png;
+}
+
+// Binary PBM. PBM stores 1 as black, so bits are inverted to keep lit
+// pixels white like on screen.
+std::vector<uint8_t> encodePbm(const components::Display::Frame &frame) {
+  const std::string header =
+      "P4\n" + std::to_string(WIDTH) + " " + std::to_string(HEIGHT) + "\n";
+  std::vector<uint8_t> pbm(header.begin(), header.end());
+  for (uint64_t row : frame) {
+    const auto bytes = rowBytes(~row);
+    pbm.insert(pbm.end(), bytes.begin(), bytes.end());
+  }
+  return pbm;
+}
+
+}  // namespace
+
+bool parseCaptureSpec(const std::string &spec, CaptureFormat &format,
+                      std::string &target) {
+  const size_t colon = spec.find(':');
+  if (colon == std::string::npos || colon + 1 == spec.size()) {
+    return false;
+  }
+  const std::string name = spec.substr(0, colon);
+  target = spec.substr(colon + 1);
+  if (name == "pbm") {
+    format = CaptureFormat::Pbm;
+  } else if (name == "png") {
+    format = CaptureFormat::Png;
+  } else if (name == "raw") {
+    format = CaptureFormat::Raw;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+FrameCapture::FrameCapture(CaptureFormat format, const std::string &target,
+                           size_t capacity)
+    : format(format), target(target), slots(capacity + 1) {}
+
+FrameCapture::~FrameCapture() { stop(); }
+
+bool FrameCapture::start() {
+  if (format == CaptureFormat::Raw) {
+    raw = target == "-" ? stdout : std::fopen(target.c_str(), "wb");
+    if (!raw) {
+      std::cerr << "Cannot open capture output: " << target << std::endl;
+      return false;
+    }
+  } else {
+    std::error_code ec;
+    std::filesystem::create_directories(target, ec);
+    if (ec) {
+      std::cerr << "Cannot create capture directory " << target << ": "
+                << ec.message() << std::endl;
+      return false;
+    }
+  }
+
+  writer = std::thread(&FrameCapture::writerLoop, this);
+  return true;
+}
+
+void FrameCapture::submit(const components::Display &disp,
+                          uint64_t frameNumber) {
+  lastNumber.store(frameNumber, std::memory_order_relaxed);
+
+  const uint64_t hash = disp.getHash();
+  if (hasLast && hash == lastHash) {
+    duplicates.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const size_t h = head.load(std::memory_order_relaxed);
+  const size_t next = (h + 1) % slots.size();
+  if (next == tail.load(std::memory_order_acquire)) {
+    // Keep lastHash untouched so the next frame is tried again even if it
+    // matches the dropped one.
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  slots[h].frame = disp.getFrame();
+  slots[h].number = frameNumber;
+  head.store(next, std::memory_order_release);
+  lastHash = hash;
+  hasLast = true;
+  wake.notify_one();
+}
+
+void FrameCapture::stop() {
+  if (!writer.joinable()) {
+    return;
+  }
+  stopping.store(true);
+  wake.notify_one();
+  writer.join();
+
+  if (raw) {
+    // Pad the stream with the last frame up to the final presented frame.
+    if (hasWritten) {
+      const uint64_t end = lastNumber.load();
+      for (uint64_t n = lastWritten.number + 1; n <= end; ++n) {
+        writeRaw(lastWritten.frame);
+      }
+    }
+    std::fflush(raw);
+    if (raw != stdout) {
+      std::fclose(raw);
+    }
+    raw = nullptr;
+  }
+}
+
+void FrameCapture::writerLoop() {
+  while (true) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      if (stopping.load()) {
+        return;
+      }
+      // Timed wait: the producer notifies without taking the mutex.
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wake.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+
+    writeSlot(slots[t]);
+    tail.store((t + 1) % slots.size(), std::memory_order_release);
+  }
+}
+
+void FrameCapture::writeSlot(const Slot &slot) {
+  bool ok = true;
+  if (format == CaptureFormat::Raw) {
+    if (hasWritten) {
+      for (uint64_t n = lastWritten.number + 1; n < slot.number; ++n) {
+        ok = writeRaw(lastWritten.frame) && ok;
+      }
+    }
+    ok = writeRaw(slot.frame) && ok;
+  } else {
+    ok = writeImage(slot);
+  }
+
+  lastWritten = slot;
+  hasWritten = true;
+  if (ok) {
+    written.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    errors.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool FrameCapture::writeImage(const Slot &slot) {
+  const bool png = format == CaptureFormat::Png;
+  const std::vector<uint8_t> data =
+      png ? encodePng(slot.frame) : encodePbm(slot.frame);
+
+  FILE *file = std::fopen(framePath(slot.number, png ? "png" : "pbm").c_str(),
+                          "wb");
+  if (!file) {
+    return false;
+  }
+  const bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+bool FrameCapture::writeRaw(const components::Display::Frame &frame) {
+  std::array<uint8_t, WIDTH * HEIGHT * 3> rgb;
+  size_t i = 0;
+  for (uint64_t row : frame) {
+    for (size_t col = 0; col < WIDTH; ++col) {
+      const uint8_t value = ((row >> (WIDTH - 1 - col)) & 1) ? 0xFF : 0x00;
+      rgb[i++] = value;
+      rgb[i++] = value;
+      rgb[i++] = value;
+    }
+  }
+  return std::fwrite(rgb.data(), 1, rgb.size(), raw) == rgb.size();
+}
+
+std::string FrameCapture::framePath(uint64_t number,
+                                    const char *extension) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "frame_%06llu.%s",
+                static_cast<unsigned long long>(number), extension);
+  return (std::filesystem::path(target) / name).string();
+}
+
+uint64_t FrameCapture::getWritten() const { return written.load(); }
+uint64_t FrameCapture::getDuplicates() const { return duplicates.load(); }
+uint64_t FrameCapture::getDropped() const { return dropped.load(); }
+uint64_t FrameCapture::getErrors() const { return errors.load(); }
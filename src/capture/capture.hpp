@@ -0,0 +1,85 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../components/components.hpp"
+
+enum class CaptureFormat { Pbm, Png, Raw };
+
+// Records presented frames without ever stalling emulation. submit() copies
+// the framebuffer into a bounded single-producer/single-consumer queue and a
+// writer thread encodes it. A full queue drops the frame and counts it.
+// Consecutive identical frames are never queued; image sequences are named
+// by emulated frame number, and the raw stream repeats the previous frame to
+// keep a constant frame rate.
+class FrameCapture {
+public:
+  // target is a directory for image sequences, or a file ("-" for stdout)
+  // for the raw RGB24 stream.
+  FrameCapture(CaptureFormat format, const std::string &target,
+               size_t capacity = 256);
+  ~FrameCapture();
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  bool start();
+  void submit(const components::Display &disp, uint64_t frameNumber);
+  // Writes everything still queued and joins the writer thread.
+  void stop();
+
+  uint64_t getWritten() const;
+  uint64_t getDuplicates() const;
+  uint64_t getDropped() const;
+  uint64_t getErrors() const;
+
+private:
+  struct Slot {
+    components::Display::Frame frame = {};
+    uint64_t number = 0;
+  };
+
+  void writerLoop();
+  void writeSlot(const Slot &slot);
+  bool writeImage(const Slot &slot);
+  bool writeRaw(const components::Display::Frame &frame);
+  std::string framePath(uint64_t number, const char *extension) const;
+
+  CaptureFormat format;
+  std::string target;
+  std::vector<Slot> slots;
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  std::atomic<bool> stopping{false};
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  std::thread writer;
+
+  // Producer side.
+  uint64_t lastHash = 0;
+  bool hasLast = false;
+  std::atomic<uint64_t> lastNumber{0};
+
+  // Writer side.
+  FILE *raw = nullptr;
+  Slot lastWritten;
+  bool hasWritten = false;
+
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> duplicates{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> errors{0};
+};
+
+// Parses "pbm:DIR", "png:DIR" or "raw:FILE" into its parts.
+bool parseCaptureSpec(const std::string &spec, CaptureFormat &format,
+                      std::string &target);
+
+#endif  // CAPTURE_HPP
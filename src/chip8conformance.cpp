@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu/cpu.hpp"
+#include "cpu/fusion.hpp"
+
+// Runs a corpus of test ROMs headlessly and compares the final framebuffer
+// hash and key registers against golden values from a manifest. One line
+// per ROM, '#' starts a comment:
+//
+//   <rom> <instructions> <hash> <pc> <i> <v0..vf> <fault> [poke:ADDR=VV ...]
+//
+// hash is the 16-digit Display::getHash(), pc and i are hex, the registers
+// are 32 hex digits and fault is "ok" or the faultName() with spaces as
+// dashes. Spaces and '%' in ROM names are written as %20 and %25. Pokes
+// are written to memory after loading, e.g. poke:1FF=01 to preselect the
+// platform in menu-driven test ROMs. --regenerate rewrites the results of
+// every entry and appends ROMs in the directory that are missing.
+// --fuse runs the corpus through runFrameFused(), which must match the same
+// goldens.
+
+namespace {
+
+const int FRAMES_PER_SECOND = 60;
+const int INSTRUCTIONS_PER_SECOND = 700;
+const uint32_t SEED = 1;
+
+struct Poke {
+  uint16_t address;
+  uint8_t value;
+};
+
+struct Result {
+  uint64_t hash = 0;
+  uint16_t pc = 0;
+  uint16_t indexReg = 0;
+  std::array<uint8_t, 16> regs = {};
+  std::string fault = "ok";
+
+  bool operator==(const Result &other) const = default;
+};
+
+struct Entry {
+  std::string rom;
+  uint64_t instructions = 0;
+  std::vector<Poke> pokes;
+  bool hasGolden = false;
+  Result golden;
+  Result actual;
+  std::string error;
+};
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --manifest=FILE [--rom-dir=DIR] [--threads=N] [--regenerate]"
+               " [--instructions=N]\n"
+               "       [--fuse]\n"
+            << "Runs every ROM in the manifest and compares it with its "
+               "golden values. ROMs\n"
+            << "are looked up next to the manifest unless --rom-dir is "
+               "given; --instructions\n"
+            << "sets the run length of ROMs added by --regenerate."
+            << std::endl;
+}
+
+std::string formatRegs(const std::array<uint8_t, 16> &regs) {
+  std::string out;
+  char byte[3];
+  for (uint8_t value : regs) {
+    std::snprintf(byte, sizeof(byte), "%02x", value);
+    out += byte;
+  }
+  return out;
+}
+
+std::string formatResult(const Result &result) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%016llx %03x %03x ",
+                static_cast<unsigned long long>(result.hash), result.pc,
+                result.indexReg);
+  return buf + formatRegs(result.regs) + " " + result.fault;
+}
+
+std::string faultToken(Fault fault) {
+  if (fault == Fault::None) {
+    return "ok";
+  }
+  std::string name = faultName(fault);
+  std::replace(name.begin(), name.end(), ' ', '-');
+  return name;
+}
+
+std::string escapeName(const std::string &name) {
+  std::string out;
+  for (char c : name) {
+    out += c == ' ' ? "%20" : c == '%' ? "%25" : std::string(1, c);
+  }
+  return out;
+}
+
+std::string unescapeName(const std::string &name) {
+  std::string out;
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (name.compare(i, 3, "%20") == 0) {
+      out += ' ';
+      i += 2;
+    } else if (name.compare(i, 3, "%25") == 0) {
+      out += '%';
+      i += 2;
+    } else {
+      out += name[i];
+    }
+  }
+  return out;
+}
+
+bool parseHex(const std::string &text, uint64_t &value) {
+  if (text.empty() || text.size() > 16) {
+    return false;
+  }
+  char *end = nullptr;
+  value = std::strtoull(text.c_str(), &end, 16);
+  return *end == '\0';
+}
+
+bool parseEntry(const std::string &line, Entry &entry) {
+  std::istringstream in(line);
+  std::vector<std::string> fields{std::istream_iterator<std::string>(in),
+                                  std::istream_iterator<std::string>()};
+  if (fields.size() < 2) {
+    return false;
+  }
+  entry.rom = unescapeName(fields[0]);
+  char *end = nullptr;
+  entry.instructions = std::strtoull(fields[1].c_str(), &end, 10);
+  if (*end != '\0' || entry.instructions == 0) {
+    return false;
+  }
+
+  size_t next = 2;
+  if (fields.size() >= 7 && fields[2].rfind("poke:", 0) != 0) {
+    uint64_t hash, pc, indexReg;
+    if (!parseHex(fields[2], hash) || !parseHex(fields[3], pc) ||
+        !parseHex(fields[4], indexReg) || fields[5].size() != 32) {
+      return false;
+    }
+    entry.golden.hash = hash;
+    entry.golden.pc = pc;
+    entry.golden.indexReg = indexReg;
+    for (size_t i = 0; i < 16; ++i) {
+      uint64_t value;
+      if (!parseHex(fields[5].substr(i * 2, 2), value)) {
+        return false;
+      }
+      entry.golden.regs[i] = value;
+    }
+    entry.golden.fault = fields[6];
+    entry.hasGolden = true;
+    next = 7;
+  }
+
+  for (; next < fields.size(); ++next) {
+    const std::string &poke = fields[next];
+    const size_t eq = poke.find('=');
+    uint64_t address, value;
+    if (poke.rfind("poke:", 0) != 0 || eq == std::string::npos ||
+        !parseHex(poke.substr(5, eq - 5), address) ||
+        !parseHex(poke.substr(eq + 1), value) || address >= MEMORY_SIZE ||
+        value > 0xFF) {
+      return false;
+    }
+    entry.pokes.push_back({uint16_t(address), uint8_t(value)});
+  }
+  return true;
+}
+
+bool readRom(const std::filesystem::path &path, std::vector<char> &rom) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  rom.assign(std::istreambuf_iterator<char>(in),
+             std::istreambuf_iterator<char>());
+  return true;
+}
+
+void runEntry(Entry &entry, const std::filesystem::path &romDir, bool fuse) {
+  std::vector<char> rom;
+  if (!readRom(romDir / entry.rom, rom)) {
+    entry.error = "cannot read ROM";
+    return;
+  }
+  Machine machine;
+  machine.rng.seed(SEED);
+  if (!machine.mem.loadIntoMemory(rom)) {
+    entry.error = "ROM does not fit in memory";
+    return;
+  }
+  for (const Poke &poke : entry.pokes) {
+    machine.mem.setByte(poke.address, poke.value);
+  }
+
+  // Same frame structure as the emulator: the budget is spread over 60 Hz
+  // frames and the timers tick between them.
+  IdleDetector idle;
+  Fuser fuser;
+  uint64_t executed = 0;
+  for (uint64_t frame = 0; executed < entry.instructions; ++frame) {
+    const uint64_t ips = INSTRUCTIONS_PER_SECOND;
+    const uint64_t budget = std::min<uint64_t>(
+        (ips * (frame + 1)) / FRAMES_PER_SECOND -
+            (ips * frame) / FRAMES_PER_SECOND,
+        entry.instructions - executed);
+    executed += fuse ? runFrameFused(machine, budget, idle, fuser)
+                     : runFrame(machine, budget, idle);
+    if (machine.fault != Fault::None) {
+      break;
+    }
+    machine.keypad.clearReleased();
+    machine.timerDelay.tick();
+    machine.timerSound.tick();
+  }
+
+  entry.actual.hash = machine.disp.getHash();
+  entry.actual.pc = machine.mem.getPC();
+  entry.actual.indexReg = machine.indexReg;
+  for (uint8_t i = 0; i < 16; ++i) {
+    entry.actual.regs[i] = machine.variableRegs.getReg(i);
+  }
+  entry.actual.fault = faultToken(machine.fault);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string manifestPath;
+  std::string romDirArg;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t defaultInstructions = 100000;
+  bool regenerate = false;
+  bool fuse = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.rfind("--manifest=", 0) == 0) {
+      manifestPath = arg.substr(11);
+    } else if (arg.rfind("--rom-dir=", 0) == 0) {
+      romDirArg = arg.substr(10);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::max(1, std::atoi(arg.c_str() + 10));
+    } else if (arg.rfind("--instructions=", 0) == 0) {
+      defaultInstructions = std::strtoull(arg.c_str() + 15, nullptr, 10);
+    } else if (arg == "--regenerate") {
+      regenerate = true;
+    } else if (arg == "--fuse") {
+      fuse = true;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (manifestPath.empty() || defaultInstructions == 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  const std::filesystem::path romDir =
+      romDirArg.empty()
+          ? std::filesystem::path(manifestPath).parent_path()
+          : std::filesystem::path(romDirArg);
+
+  std::vector<Entry> entries;
+  std::ifstream manifest(manifestPath);
+  if (!manifest && !regenerate) {
+    std::cerr << "Cannot read manifest " << manifestPath << std::endl;
+    return 1;
+  }
+  std::string line;
+  for (int lineNumber = 1; std::getline(manifest, line); ++lineNumber) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    Entry entry;
+    if (!parseEntry(line, entry)) {
+      std::cerr << manifestPath << ":" << lineNumber << ": bad entry"
+                << std::endl;
+      return 1;
+    }
+    entries.push_back(entry);
+  }
+  manifest.close();
+
+  if (regenerate) {
+    std::error_code error;
+    std::vector<std::string> found;
+    for (const auto &file :
+         std::filesystem::directory_iterator(romDir.empty() ? "." : romDir,
+                                             error)) {
+      if (file.path().extension() == ".ch8") {
+        found.push_back(file.path().filename().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    for (const std::string &rom : found) {
+      const bool known =
+          std::any_of(entries.begin(), entries.end(),
+                      [&](const Entry &entry) { return entry.rom == rom; });
+      if (!known) {
+        Entry entry;
+        entry.rom = rom;
+        entry.instructions = defaultInstructions;
+        entries.push_back(entry);
+      }
+    }
+  }
+
+  // Entries are independent; workers pull the next one off a shared index.
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> nextEntry{0};
+  auto worker = [&] {
+    for (size_t i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      runEntry(entries[i], romDir, fuse);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < std::min<size_t>(threads, entries.size()); ++t) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+  if (regenerate) {
+    // Leave the manifest untouched unless every entry ran, and replace it in
+    // one step so an interrupted write cannot truncate it.
+    bool ran = true;
+    for (const Entry &entry : entries) {
+      if (!entry.error.empty()) {
+        std::cerr << entry.rom << ": " << entry.error << std::endl;
+        ran = false;
+      }
+    }
+    if (!ran) {
+      return 1;
+    }
+    const std::string tempPath = manifestPath + ".tmp";
+    std::ofstream out(tempPath);
+    out << "# rom instructions hash pc i v0..vf fault [poke:ADDR=VV ...]\n";
+    for (const Entry &entry : entries) {
+      out << escapeName(entry.rom) << ' ' << entry.instructions << ' '
+          << formatResult(entry.actual);
+      for (const Poke &poke : entry.pokes) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), " poke:%03X=%02X", poke.address,
+                      poke.value);
+        out << buf;
+      }
+      out << '\n';
+    }
+    out.close();
+    std::error_code error;
+    if (!out) {
+      std::cerr << "Cannot write manifest " << tempPath << std::endl;
+      std::filesystem::remove(tempPath, error);
+      return 1;
+    }
+    std::filesystem::rename(tempPath, manifestPath, error);
+    if (error) {
+      std::cerr << "Cannot replace manifest " << manifestPath << ": "
+                << error.message() << std::endl;
+      std::filesystem::remove(tempPath, error);
+      return 1;
+    }
+    std::cout << "Regenerated " << entries.size() << " goldens in "
+              << seconds << "s" << std::endl;
+    return 0;
+  }
+
+  size_t failed = 0;
+  for (const Entry &entry : entries) {
+    if (!entry.error.empty()) {
+      std::cout << "FAIL " << entry.rom << ": " << entry.error << std::endl;
+      failed++;
+    } else if (!entry.hasGolden) {
+      std::cout << "FAIL " << entry.rom << ": no golden values" << std::endl;
+      failed++;
+    } else if (!(entry.actual == entry.golden)) {
+      std::cout << "FAIL " << entry.rom << "\n  expected "
+                << formatResult(entry.golden) << "\n  actual   "
+                << formatResult(entry.actual) << std::endl;
+      failed++;
+    } else {
+      std::cout << "PASS " << entry.rom << std::endl;
+    }
+  }
+  std::cout << entries.size() - failed << "/" << entries.size()
+            << " passed in " << seconds << "s" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
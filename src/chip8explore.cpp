@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stack>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "cpu/cpu.hpp"
+
+// Explores input sequences from a start state, for automated game testing.
+// Every search level forks each frontier machine once per action by copying
+// it, holds the action's key for a few frames, and hashes the resulting
+// RAM, registers, stack, timers and framebuffer. States seen before are
+// pruned through a concurrent hash set; the rest are ranked by an objective
+// read from RAM (score, level, ...) and the best --beam of them become the
+// next frontier. Children are expanded on all cores.
+//
+// Memory stays bounded: the frontier holds at most --beam machines, each
+// worker keeps at most twice that many candidates, and a shard of the hash
+// set that reaches its share of --max-states is cleared, which costs some
+// re-exploration rather than memory.
+
+namespace {
+
+const int FRAMES_PER_SECOND = 60;
+const size_t SHARDS = 64;
+// Action index meaning no key held.
+const int8_t NO_KEY = -1;
+
+// Objective term: scale * (byte at address, or big-endian word when wide).
+struct Probe {
+  uint16_t address = 0;
+  double scale = 1.0;
+  bool wide = false;
+};
+
+struct Node {
+  Machine machine;
+  uint64_t frame = 0;
+  uint64_t hash = 0;
+  double score = 0.0;
+  // Key held during each step from the start state, NO_KEY for none.
+  std::vector<int8_t> path;
+};
+
+// Visited state hashes, sharded so that threads rarely contend.
+class StateSet {
+public:
+  explicit StateSet(size_t capacity)
+      : shardCapacity(std::max<size_t>(1, capacity / SHARDS)) {}
+
+  // Returns true if the hash was not in the set yet.
+  bool insert(uint64_t hash) {
+    Shard &shard = shards[(hash >> 58) % SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.hashes.size() >= shardCapacity) {
+      shard.hashes.clear();
+      evictions++;
+    }
+    return shard.hashes.insert(hash).second;
+  }
+
+  uint64_t getEvictions() const { return evictions; }
+
+private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_set<uint64_t> hashes;
+  };
+
+  std::array<Shard, SHARDS> shards;
+  size_t shardCapacity;
+  std::atomic<uint64_t> evictions{0};
+};
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --rom=FILE --probe=ADDR[:w][*SCALE] [--probe=...]"
+               " [--depth=N] [--beam=N]\n"
+            << "       [--frames-per-action=N] [--keys=HEX] [--warmup=N]"
+               " [--max-states=N]\n"
+            << "       [--threads=N] [--ips=N] [--seed=N]\n"
+            << "Searches key sequences that maximize the sum of the probes, "
+               "e.g. --probe=2F0:w\n"
+            << "for a big-endian score word at 0x2F0. --keys limits the "
+               "keys tried (default\n"
+            << "all 16, plus no key)." << std::endl;
+}
+
+bool parseProbe(const std::string &text, Probe &probe) {
+  std::string address = text;
+  const size_t star = address.find('*');
+  if (star != std::string::npos) {
+    char *end = nullptr;
+    probe.scale = std::strtod(address.c_str() + star + 1, &end);
+    if (*end != '\0' || star + 1 == address.size()) {
+      return false;
+    }
+    address.resize(star);
+  }
+  if (address.size() > 2 &&
+      address.compare(address.size() - 2, 2, ":w") == 0) {
+    probe.wide = true;
+    address.resize(address.size() - 2);
+  }
+  char *end = nullptr;
+  const unsigned long value = std::strtoul(address.c_str(), &end, 16);
+  if (address.empty() || *end != '\0' ||
+      value + (probe.wide ? 1 : 0) >= MEMORY_SIZE) {
+    return false;
+  }
+  probe.address = value;
+  return true;
+}
+
+double objective(const Machine &machine, const std::vector<Probe> &probes) {
+  double total = 0.0;
+  for (const Probe &probe : probes) {
+    double value = machine.mem.getByte(probe.address);
+    if (probe.wide) {
+      value = value * 256 + machine.mem.getByte(probe.address + 1);
+    }
+    total += probe.scale * value;
+  }
+  return total;
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * 0x100000001B3ULL;
+  return hash ^ (hash >> 29);
+}
+
+// The stack's entries in place; std::stack only exposes its top.
+const std::stack<uint16_t>::container_type &stackEntries(
+    const std::stack<uint16_t> &stack) {
+  struct Access : std::stack<uint16_t> {
+    static const container_type &of(const std::stack<uint16_t> &stack) {
+      return stack.*&Access::c;
+    }
+  };
+  return Access::of(stack);
+}
+
+// Everything that decides how the machine continues, except the random
+// generator, whose state is not observable. Held keys count because the
+// next action's key changes produce release events that FX0A reacts to.
+uint64_t stateHash(const Machine &machine) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (size_t address = 0; address < MEMORY_SIZE; address += 8) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      word = (word << 8) | machine.mem.getByte(address + i);
+    }
+    hash = mix(hash, word);
+  }
+  for (uint8_t reg = 0; reg < 16; ++reg) {
+    hash = mix(hash, machine.variableRegs.getReg(reg));
+  }
+  hash = mix(hash, (uint64_t(machine.mem.getPC()) << 16) | machine.indexReg);
+  hash = mix(hash, (uint64_t(machine.timerDelay.getValue()) << 8) |
+                       machine.timerSound.getValue());
+  hash = mix(hash, machine.keypad.getState());
+  const auto &stack = stackEntries(machine.stack);
+  hash = mix(hash, stack.size());
+  for (uint16_t entry : stack) {
+    hash = mix(hash, entry);
+  }
+  return mix(hash, machine.disp.getHash());
+}
+
+// Holds the keys in mask for the given number of frames, ticking the timers
+// between frames like the emulator does.
+void runFrames(Node &node, uint16_t mask, int frames,
+               uint64_t instructionsPerSecond) {
+  Machine &machine = node.machine;
+  for (uint8_t key = 0; key < 16; ++key) {
+    machine.keypad.setKey(key, (mask >> key) & 1);
+  }
+  IdleDetector idle;
+  const uint64_t ips = instructionsPerSecond;
+  for (int f = 0; f < frames && machine.fault == Fault::None; ++f) {
+    const size_t budget = (ips * (node.frame + 1)) / FRAMES_PER_SECOND -
+                          (ips * node.frame) / FRAMES_PER_SECOND;
+    runFrame(machine, budget, idle);
+    node.frame++;
+    machine.keypad.clearReleased();
+    machine.timerDelay.tick();
+    machine.timerSound.tick();
+  }
+}
+
+// Best first; equal scores are ordered by hash so that the frontier does
+// not depend on thread scheduling.
+bool better(const Node &a, const Node &b) {
+  return a.score != b.score ? a.score > b.score : a.hash < b.hash;
+}
+
+void keepBest(std::vector<Node> &nodes, size_t count) {
+  if (nodes.size() <= count) {
+    return;
+  }
+  std::nth_element(nodes.begin(), nodes.begin() + count, nodes.end(), better);
+  nodes.resize(count);
+}
+
+std::string formatPath(const std::vector<int8_t> &path) {
+  static const char digits[] = "0123456789ABCDEF";
+  std::string out;
+  for (int8_t key : path) {
+    if (!out.empty()) {
+      out += ' ';
+    }
+    out += key == NO_KEY ? '-' : digits[key];
+  }
+  return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string romPath;
+  std::vector<Probe> probes;
+  std::vector<int8_t> actions;
+  int depth = 60;
+  size_t beam = 256;
+  int framesPerAction = 4;
+  int warmup = 0;
+  size_t maxStates = 1 << 22;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int instructionsPerSecond = 700;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    bool ok = true;
+    if (arg.rfind("--rom=", 0) == 0) {
+      romPath = arg.substr(6);
+    } else if (arg.rfind("--probe=", 0) == 0) {
+      Probe probe;
+      ok = parseProbe(arg.substr(8), probe);
+      probes.push_back(probe);
+    } else if (arg.rfind("--keys=", 0) == 0) {
+      for (char c : arg.substr(7)) {
+        const char digit[] = {c, '\0'};
+        const int key = std::isxdigit(static_cast<unsigned char>(c))
+                            ? std::strtol(digit, nullptr, 16)
+                            : -1;
+        ok = ok && key >= 0 &&
+             std::find(actions.begin(), actions.end(), key) == actions.end();
+        actions.push_back(key);
+      }
+    } else if (arg.rfind("--depth=", 0) == 0) {
+      depth = std::atoi(arg.c_str() + 8);
+    } else if (arg.rfind("--beam=", 0) == 0) {
+      beam = std::strtoull(arg.c_str() + 7, nullptr, 10);
+    } else if (arg.rfind("--frames-per-action=", 0) == 0) {
+      framesPerAction = std::atoi(arg.c_str() + 20);
+    } else if (arg.rfind("--warmup=", 0) == 0) {
+      warmup = std::atoi(arg.c_str() + 9);
+    } else if (arg.rfind("--max-states=", 0) == 0) {
+      maxStates = std::strtoull(arg.c_str() + 13, nullptr, 10);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::max(1, std::atoi(arg.c_str() + 10));
+    } else if (arg.rfind("--ips=", 0) == 0) {
+      instructionsPerSecond = std::atoi(arg.c_str() + 6);
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = std::strtoul(arg.c_str() + 7, nullptr, 10);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (romPath.empty() || probes.empty() || depth <= 0 || beam == 0 ||
+      framesPerAction <= 0 || warmup < 0 || maxStates == 0 ||
+      instructionsPerSecond <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if (actions.empty()) {
+    for (int8_t key = 0; key < 16; ++key) {
+      actions.push_back(key);
+    }
+  }
+  actions.insert(actions.begin(), NO_KEY);
+
+  Node start;
+  start.machine.rng.seed(seed);
+  const std::vector<char> rom = start.machine.mem.readBinaryFile(romPath);
+  if (!start.machine.mem.loadIntoMemory(rom)) {
+    std::cerr << "ROM does not fit in memory: " << romPath << std::endl;
+    return 1;
+  }
+  runFrames(start, 0, warmup, instructionsPerSecond);
+  start.hash = stateHash(start.machine);
+  start.score = objective(start.machine, probes);
+
+  StateSet seen(maxStates);
+  seen.insert(start.hash);
+  Node best = start;
+  std::vector<Node> frontier{start};
+  uint64_t expanded = 0;
+  uint64_t duplicates = 0;
+  uint64_t faulted = 0;
+  const auto startTime = std::chrono::steady_clock::now();
+
+  for (int level = 1; level <= depth && !frontier.empty(); ++level) {
+    // Workers pull parents off a shared index and keep their own bounded
+    // candidate lists, merged once the level is done.
+    const size_t jobs = frontier.size() * actions.size();
+    const unsigned workers = std::min<size_t>(threads, jobs);
+    std::vector<std::vector<Node>> candidates(workers);
+    std::atomic<size_t> nextJob{0};
+    std::atomic<uint64_t> levelDuplicates{0};
+    std::atomic<uint64_t> levelFaulted{0};
+    auto worker = [&](unsigned id) {
+      std::vector<Node> &mine = candidates[id];
+      for (size_t job = nextJob++; job < jobs; job = nextJob++) {
+        const Node &parent = frontier[job / actions.size()];
+        const int8_t action = actions[job % actions.size()];
+        Node child = parent;
+        runFrames(child, action == NO_KEY ? 0 : 1 << action,
+                  framesPerAction, instructionsPerSecond);
+        if (child.machine.fault != Fault::None) {
+          levelFaulted++;
+          continue;
+        }
+        child.hash = stateHash(child.machine);
+        if (!seen.insert(child.hash)) {
+          levelDuplicates++;
+          continue;
+        }
+        child.score = objective(child.machine, probes);
+        child.path.push_back(action);
+        mine.push_back(std::move(child));
+        if (mine.size() >= 2 * beam) {
+          keepBest(mine, beam);
+        }
+      }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned id = 1; id < workers; ++id) {
+      pool.emplace_back(worker, id);
+    }
+    worker(0);
+    for (std::thread &thread : pool) {
+      thread.join();
+    }
+
+    frontier.clear();
+    for (std::vector<Node> &mine : candidates) {
+      std::move(mine.begin(), mine.end(), std::back_inserter(frontier));
+    }
+    keepBest(frontier, beam);
+    std::sort(frontier.begin(), frontier.end(), better);
+
+    expanded += jobs;
+    duplicates += levelDuplicates;
+    faulted += levelFaulted;
+    if (!frontier.empty() && frontier.front().score > best.score) {
+      best = frontier.front();
+    }
+    std::cerr << "depth " << level << ": " << jobs << " expanded, "
+              << levelDuplicates << " duplicate, " << levelFaulted
+              << " faulted, frontier " << frontier.size() << ", best "
+              << (frontier.empty() ? best.score : frontier.front().score)
+              << std::endl;
+  }
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - startTime)
+                             .count();
+  const double rate = expanded / std::max(seconds, 1e-9);
+  std::cout << "Explored " << expanded << " states (" << duplicates
+            << " duplicate, " << faulted << " faulted, "
+            << seen.getEvictions() << " set evictions) in " << seconds
+            << "s, " << static_cast<uint64_t>(rate) << " states/s"
+            << std::endl;
+  std::cout << "Best objective " << best.score << " after "
+            << best.path.size() << " actions of " << framesPerAction
+            << " frames (hex key held per action, - for none):\n"
+            << formatPath(best.path) << std::endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "cpu/cpu.hpp"
+
+// libFuzzer harness for the interpreter core. An input is
+//   u8 n, n little-endian u16 keypad masks, then the ROM bytes.
+// Each mask is held for one frame, cycling when the sequence runs out, and
+// every input runs for a bounded number of frames. Build with
+// cmake -DCHIP8_FUZZ=ON (clang only).
+
+namespace {
+
+const int FRAMES = 16;
+const size_t INSTRUCTIONS_PER_FRAME = 64;
+const uint16_t ROM_START = 0x200;
+
+void fail(const char *invariant, const Machine &machine) {
+  std::fprintf(stderr, "invariant violated: %s (PC=%03X SP=%zu I=%04X)\n",
+               invariant, machine.mem.getPC(), machine.stack.size(),
+               machine.indexReg);
+  std::abort();
+}
+
+// Built once; every input starts from a copy of it. Assigning over a
+// machine of the same shape copies the memory buffers in place, so an
+// iteration does not allocate.
+const Machine &pristine() {
+  static const Machine machine = [] {
+    Machine m;
+    m.rng.seed(0x2545F491);
+    return m;
+  }();
+  return machine;
+}
+
+void checkInvariants(const Machine &machine) {
+  if (machine.stack.size() > STACK_DEPTH) {
+    fail("stack depth", machine);
+  }
+  // Jumps land inside the 12-bit address space; only the fetch increment
+  // and a skip can step past the end, and the next fetch must fault.
+  if (machine.mem.getPC() >= MEMORY_SIZE + 4) {
+    fail("PC in range", machine);
+  }
+  if (machine.fault != Fault::None && machine.mem.getPC() != machine.faultPC) {
+    fail("PC left at the faulting instruction", machine);
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  const size_t keyCount = std::min<size_t>(data[0], (size - 1) / 2);
+  const uint8_t *keys = data + 1;
+  const uint8_t *rom = keys + keyCount * 2;
+  const size_t romSize = std::min<size_t>(data + size - rom,
+                                          MEMORY_SIZE - ROM_START);
+
+  static Machine machine;
+  static IdleDetector idle;
+  machine = pristine();
+  for (size_t i = 0; i < romSize; ++i) {
+    machine.mem.setByte(ROM_START + i, rom[i]);
+  }
+
+  for (int frame = 0; frame < FRAMES; ++frame) {
+    if (keyCount > 0) {
+      const size_t k = (frame % keyCount) * 2;
+      const uint16_t mask = keys[k] | (keys[k + 1] << 8);
+      for (uint8_t key = 0; key < 16; ++key) {
+        machine.keypad.setKey(key, (mask >> key) & 1);
+      }
+    }
+
+    // Same loop as runFrame(), with the invariants checked after every
+    // instruction and a fetch past the end required to fault.
+    idle.reset();
+    size_t executed = 0;
+    while (executed < INSTRUCTIONS_PER_FRAME) {
+      const uint16_t pc = machine.mem.getPC();
+      uint16_t instruction = 0;
+      const bool ok = step(machine, instruction);
+      checkInvariants(machine);
+      if (!ok) {
+        break;
+      }
+      if (pc >= MEMORY_SIZE - 1) {
+        fail("fetch past the end of memory", machine);
+      }
+      ++executed;
+      executed += idle.observe(pc, instruction, machine,
+                               INSTRUCTIONS_PER_FRAME - executed);
+    }
+    if (machine.fault != Fault::None) {
+      break;
+    }
+
+    machine.keypad.clearReleased();
+    machine.timerDelay.tick();
+    machine.timerSound.tick();
+  }
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "components/components.hpp"
+#include "gym/env.hpp"
+
+// Steps a BatchEnv with uniformly random key masks and reports throughput,
+// finished episodes and the reward collected. Serves as a usage example of
+// the environment API and as a quick check that a reward probe moves.
+
+namespace {
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --rom=FILE [--batch=N] [--steps=N] [--threads=N]"
+               " [--ips=N]\n"
+               "       [--frames-per-step=N] [--max-steps=N] [--seed=N]\n"
+               "       [--reward=ADDR[:w][*SCALE] ...] [--shm=NAME]\n"
+            << "Runs a batch of environments with random actions. "
+               "--shm writes the\n"
+            << "observations into POSIX shared memory NAME (e.g. "
+               "/chip8-obs)."
+            << std::endl;
+}
+
+bool parseReward(const std::string &text, RewardProbe &probe) {
+  std::string address = text;
+  const size_t star = address.find('*');
+  if (star != std::string::npos) {
+    char *end = nullptr;
+    probe.scale = std::strtof(address.c_str() + star + 1, &end);
+    if (*end != '\0' || star + 1 == address.size()) {
+      return false;
+    }
+    address.resize(star);
+  }
+  if (address.size() > 2 &&
+      address.compare(address.size() - 2, 2, ":w") == 0) {
+    probe.wide = true;
+    address.resize(address.size() - 2);
+  }
+  char *end = nullptr;
+  const unsigned long value = std::strtoul(address.c_str(), &end, 16);
+  if (address.empty() || *end != '\0' || value > 0xFFFF) {
+    return false;
+  }
+  probe.address = value;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string romPath;
+  std::string shmName;
+  EnvConfig config;
+  size_t batch = 64;
+  long long steps = 1000;
+  size_t threads = 0;
+  uint64_t seed = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    bool ok = true;
+    if (arg.rfind("--rom=", 0) == 0) {
+      romPath = arg.substr(6);
+    } else if (arg.rfind("--batch=", 0) == 0) {
+      batch = std::strtoull(arg.c_str() + 8, nullptr, 10);
+    } else if (arg.rfind("--steps=", 0) == 0) {
+      steps = std::atoll(arg.c_str() + 8);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::strtoull(arg.c_str() + 10, nullptr, 10);
+    } else if (arg.rfind("--ips=", 0) == 0) {
+      config.instructionsPerSecond = std::atoi(arg.c_str() + 6);
+    } else if (arg.rfind("--frames-per-step=", 0) == 0) {
+      config.framesPerStep = std::atoi(arg.c_str() + 18);
+    } else if (arg.rfind("--max-steps=", 0) == 0) {
+      config.maxSteps = std::atoi(arg.c_str() + 12);
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = std::strtoull(arg.c_str() + 7, nullptr, 10);
+    } else if (arg.rfind("--reward=", 0) == 0) {
+      RewardProbe probe;
+      ok = parseReward(arg.substr(9), probe);
+      config.rewards.push_back(probe);
+    } else if (arg.rfind("--shm=", 0) == 0) {
+      shmName = arg.substr(6);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (romPath.empty() || batch == 0 || steps <= 0 ||
+      config.instructionsPerSecond <= 0 || config.framesPerStep <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  components::Memory loader;
+  config.rom = loader.readBinaryFile(romPath);
+
+  std::unique_ptr<BatchEnv> env;
+  try {
+    env = std::make_unique<BatchEnv>(config, batch, threads);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << romPath << ": " << error.what() << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<SharedObservations> shared;
+  std::vector<uint8_t> local;
+  uint8_t *observations = nullptr;
+  if (!shmName.empty()) {
+    shared = std::make_unique<SharedObservations>(shmName, batch);
+    if (!shared->isValid()) {
+      std::cerr << "Cannot create shared memory " << shmName << std::endl;
+      return 1;
+    }
+    observations = shared->data();
+  } else {
+    local.resize(batch * OBSERVATION_SIZE);
+    observations = local.data();
+  }
+  std::vector<uint16_t> actions(batch);
+  std::vector<float> rewards(batch);
+  std::vector<uint8_t> dones(batch);
+
+  std::mt19937_64 rng(seed);
+  env->reset(seed, observations);
+  double totalReward = 0.0;
+  uint64_t episodes = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (long long step = 0; step < steps; ++step) {
+    for (uint16_t &action : actions) {
+      // One key or none, like a player would press.
+      const unsigned key = rng() % 17;
+      action = key == 16 ? 0 : 1 << key;
+    }
+    env->step(actions.data(), observations, rewards.data(), dones.data());
+    for (size_t i = 0; i < batch; ++i) {
+      totalReward += rewards[i];
+      episodes += dones[i];
+    }
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+  const double envSteps = double(steps) * batch;
+  std::cout << "Stepped " << batch << " environments " << steps << " times in "
+            << seconds << "s (" << envSteps / seconds << " env steps/s, "
+            << envSteps * config.framesPerStep / seconds << " frames/s)\n"
+            << "Episodes finished: " << episodes
+            << ", total reward: " << totalReward << std::endl;
+  return 0;
+}
@@ -0,0 +1,771 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu/cpu.hpp"
+
+// Statically analyzes every ROM under a directory tree and writes one JSON
+// report. Code is what is reachable from 0x200 by following the control
+// flow; every other ROM byte counts as data. A forward pass also tracks I
+// where it is a constant (set by ANNN and not changed since), so FX33/FX55
+// writes that land inside code are reported as self-modifying sites, and
+// writes whose target cannot be resolved are counted.
+//
+// Quirk dependencies are code whose result differs between interpreters:
+//   shift     8XY6/8XYE with X != Y (shifts VY or VX)
+//   jump      BNNN with a nonzero X (jumps by V0 or VX)
+//   memory    FX55/FX65 followed by a use of I before it is set again
+//             (I kept or incremented)
+//   vf-reset  8XY1/8XY2/8XY3 followed by a read of VF before it is set
+//             again (VF reset by logic ops or not)
+// The memory and vf-reset checks follow the straight-line path after the
+// instruction and give up at the first branch, so they under-report.
+// SUPER-CHIP and XO-CHIP opcodes are listed as "extensions"; this
+// interpreter faults on them.
+
+namespace {
+
+const uint16_t ROM_START = 0x200;
+const int FOLLOW_LIMIT = 32;
+
+struct SelfWrite {
+  uint16_t pc;
+  uint16_t opcode;
+  uint16_t start;
+  uint16_t length;
+};
+
+struct Report {
+  std::string path;
+  size_t size = 0;
+  std::string error;
+  size_t instructions = 0;
+  size_t codeBytes = 0;
+  size_t dataBytes = 0;
+  size_t computedJumps = 0;
+  size_t invalid = 0;
+  size_t unresolvedWrites = 0;
+  std::map<std::string, uint64_t> opcodes;
+  std::array<uint64_t, 16> spriteHeights = {};
+  std::vector<std::pair<uint16_t, uint16_t>> codeRanges;
+  std::vector<SelfWrite> selfWrites;
+  std::map<std::string, std::vector<uint16_t>> quirks;
+  std::vector<std::pair<uint16_t, uint16_t>> listing;
+};
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --rom-dir=DIR [--out=FILE] [--threads=N] [--listing]\n"
+            << "Disassembles every .ch8/.c8 ROM under DIR and writes opcode "
+               "statistics,\n"
+            << "self-modifying writes and quirk dependencies as JSON to FILE "
+               "(default stdout).\n"
+            << "--listing adds each ROM's reachable instructions."
+            << std::endl;
+}
+
+// Opcode pattern with the operand nibbles as letters, or "" if neither this
+// interpreter nor SUPER-CHIP/XO-CHIP define it.
+std::string pattern(uint16_t op) {
+  const uint8_t n = opN(op);
+  const uint8_t nn = opNN(op);
+  switch (opCode(op)) {
+    case 0x0:
+      if (op == 0x00E0 || op == 0x00EE) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "%04X", op);
+        return buf;
+      }
+      if ((op & 0xFFF0) == 0x00C0) {
+        return "00CN";
+      }
+      if ((op & 0xFFF0) == 0x00D0) {
+        return "00DN";
+      }
+      if (op >= 0x00FB && op <= 0x00FF) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "%04X", op);
+        return buf;
+      }
+      return "0NNN";
+    case 0x1:
+      return "1NNN";
+    case 0x2:
+      return "2NNN";
+    case 0x3:
+      return "3XNN";
+    case 0x4:
+      return "4XNN";
+    case 0x5:
+      return n == 0 ? "5XY0" : n == 2 ? "5XY2" : n == 3 ? "5XY3" : "";
+    case 0x6:
+      return "6XNN";
+    case 0x7:
+      return "7XNN";
+    case 0x8:
+      if (n <= 7 || n == 0xE) {
+        const char *names = "0123456789ABCDEF";
+        return std::string("8XY") + names[n];
+      }
+      return "";
+    case 0x9:
+      return n == 0 ? "9XY0" : "";
+    case 0xA:
+      return "ANNN";
+    case 0xB:
+      return "BNNN";
+    case 0xC:
+      return "CXNN";
+    case 0xD:
+      return "DXYN";
+    case 0xE:
+      return nn == 0x9E ? "EX9E" : nn == 0xA1 ? "EXA1" : "";
+    case 0xF:
+      if (op == 0xF000 || op == 0xF002) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "%04X", op);
+        return buf;
+      }
+      switch (nn) {
+        case 0x01: return "FX01";
+        case 0x07: return "FX07";
+        case 0x0A: return "FX0A";
+        case 0x15: return "FX15";
+        case 0x18: return "FX18";
+        case 0x1E: return "FX1E";
+        case 0x29: return "FX29";
+        case 0x30: return "FX30";
+        case 0x33: return "FX33";
+        case 0x3A: return "FX3A";
+        case 0x55: return "FX55";
+        case 0x65: return "FX65";
+        case 0x75: return "FX75";
+        case 0x85: return "FX85";
+      }
+      return "";
+  }
+  return "";
+}
+
+bool isExtension(const std::string &name) {
+  static const char *const EXTENSIONS[] = {
+      "00CN", "00DN", "00FB", "00FC", "00FD", "00FE", "00FF", "5XY2",
+      "5XY3", "F000", "F002", "FX01", "FX30", "FX3A", "FX75", "FX85"};
+  return std::find(std::begin(EXTENSIONS), std::end(EXTENSIONS), name) !=
+         std::end(EXTENSIONS);
+}
+
+// Assembly in the common Cowgod syntax. Operand letters pick the fields
+// passed to the format: x = X, y = Y, n = N, b = NN, a = NNN.
+struct Syntax {
+  const char *pattern;
+  const char *format;
+  const char *operands;
+};
+
+const Syntax SYNTAX[] = {
+    {"00E0", "CLS", ""},           {"00EE", "RET", ""},
+    {"0NNN", "SYS %03X", "a"},     {"1NNN", "JP %03X", "a"},
+    {"2NNN", "CALL %03X", "a"},    {"3XNN", "SE V%X, %02X", "xb"},
+    {"4XNN", "SNE V%X, %02X", "xb"}, {"5XY0", "SE V%X, V%X", "xy"},
+    {"6XNN", "LD V%X, %02X", "xb"}, {"7XNN", "ADD V%X, %02X", "xb"},
+    {"8XY0", "LD V%X, V%X", "xy"}, {"8XY1", "OR V%X, V%X", "xy"},
+    {"8XY2", "AND V%X, V%X", "xy"}, {"8XY3", "XOR V%X, V%X", "xy"},
+    {"8XY4", "ADD V%X, V%X", "xy"}, {"8XY5", "SUB V%X, V%X", "xy"},
+    {"8XY6", "SHR V%X, V%X", "xy"}, {"8XY7", "SUBN V%X, V%X", "xy"},
+    {"8XYE", "SHL V%X, V%X", "xy"}, {"9XY0", "SNE V%X, V%X", "xy"},
+    {"ANNN", "LD I, %03X", "a"},   {"BNNN", "JP V0, %03X", "a"},
+    {"CXNN", "RND V%X, %02X", "xb"}, {"DXYN", "DRW V%X, V%X, %X", "xyn"},
+    {"EX9E", "SKP V%X", "x"},      {"EXA1", "SKNP V%X", "x"},
+    {"FX07", "LD V%X, DT", "x"},   {"FX0A", "LD V%X, K", "x"},
+    {"FX15", "LD DT, V%X", "x"},   {"FX18", "LD ST, V%X", "x"},
+    {"FX1E", "ADD I, V%X", "x"},   {"FX29", "LD F, V%X", "x"},
+    {"FX33", "LD B, V%X", "x"},    {"FX55", "LD [I], V%X", "x"},
+    {"FX65", "LD V%X, [I]", "x"},
+};
+
+std::string mnemonic(uint16_t op) {
+  const std::string name = pattern(op);
+  char buf[32];
+  for (const Syntax &syntax : SYNTAX) {
+    if (name != syntax.pattern) {
+      continue;
+    }
+    unsigned values[3] = {};
+    for (int i = 0; syntax.operands[i] != '\0'; ++i) {
+      switch (syntax.operands[i]) {
+        case 'x':
+          values[i] = opX(op);
+          break;
+        case 'y':
+          values[i] = opY(op);
+          break;
+        case 'n':
+          values[i] = opN(op);
+          break;
+        case 'b':
+          values[i] = opNN(op);
+          break;
+        case 'a':
+          values[i] = opNNN(op);
+          break;
+      }
+    }
+    std::snprintf(buf, sizeof(buf), syntax.format, values[0], values[1],
+                  values[2]);
+    return buf;
+  }
+  if (isExtension(name)) {
+    return name + " (extension)";
+  }
+  std::snprintf(buf, sizeof(buf), "DW %04X", op);
+  return buf;
+}
+
+// Registers (bit N = VN) and I read and written by an instruction.
+struct Use {
+  uint16_t reads = 0;
+  uint16_t writes = 0;
+  bool readsI = false;
+  bool writesI = false;
+};
+
+Use uses(uint16_t op) {
+  const uint16_t vx = 1 << opX(op);
+  const uint16_t vy = 1 << opY(op);
+  const uint16_t vf = 1 << 0xF;
+  const uint16_t upToX = (2 << opX(op)) - 1;
+  Use use;
+  switch (opCode(op)) {
+    case 0x3:
+    case 0x4:
+    case 0x7:
+    case 0xE:
+      use.reads = vx;
+      use.writes = opCode(op) == 0x7 ? vx : 0;
+      break;
+    case 0x5:
+    case 0x9:
+      use.reads = vx | vy;
+      break;
+    case 0x6:
+    case 0xC:
+      use.writes = vx;
+      break;
+    case 0x8:
+      use.reads = opN(op) == 0 ? vy : vx | vy;
+      use.writes = opN(op) == 0 ? vx : vx | vf;
+      break;
+    case 0xA:
+      use.writesI = true;
+      break;
+    case 0xB:
+      use.reads = 1;
+      break;
+    case 0xD:
+      use.reads = vx | vy;
+      use.writes = vf;
+      use.readsI = true;
+      break;
+    case 0xF:
+      switch (opNN(op)) {
+        case 0x07:
+        case 0x0A:
+          use.writes = vx;
+          break;
+        case 0x15:
+        case 0x18:
+          use.reads = vx;
+          break;
+        case 0x1E:
+          use.reads = vx;
+          use.readsI = use.writesI = true;
+          break;
+        case 0x29:
+          use.reads = vx;
+          use.writesI = true;
+          break;
+        case 0x33:
+          use.reads = vx;
+          use.readsI = true;
+          break;
+        case 0x55:
+          use.reads = upToX;
+          use.readsI = true;
+          break;
+        case 0x65:
+          use.writes = upToX;
+          use.readsI = true;
+          break;
+      }
+      break;
+  }
+  return use;
+}
+
+struct Image {
+  std::array<uint8_t, MEMORY_SIZE> bytes = {};
+  size_t end = ROM_START;
+
+  bool fetchable(uint32_t pc) const { return pc >= ROM_START && pc + 1 < end; }
+  uint16_t at(uint16_t pc) const { return (bytes[pc] << 8) | bytes[pc + 1]; }
+};
+
+// Follows the straight-line path after pc until an instruction reads or
+// writes what is being tracked; true if it is read first.
+template <typename Reads, typename Writes>
+bool readBeforeWrite(const Image &image, uint16_t pc, Reads reads,
+                     Writes writes) {
+  for (int i = 0; i < FOLLOW_LIMIT; ++i) {
+    pc += 2;
+    if (!image.fetchable(pc)) {
+      return false;
+    }
+    const uint16_t op = image.at(pc);
+    const Use use = uses(op);
+    if (reads(use)) {
+      return true;
+    }
+    if (writes(use)) {
+      return false;
+    }
+    const uint8_t code = opCode(op);
+    if (code == 0x1) {
+      pc = opNNN(op) - 2;
+    } else if (code == 0x0 || code == 0x2 || code == 0x3 || code == 0x4 ||
+               code == 0x5 || code == 0x9 || code == 0xB || code == 0xE) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void analyze(Report &report, const std::vector<char> &rom, bool listing) {
+  Image image;
+  std::copy(rom.begin(), rom.end(), image.bytes.begin() + ROM_START);
+  image.end = ROM_START + rom.size();
+
+  // Per instruction start: whether I is a known constant on every path in.
+  enum : uint8_t { Unvisited, Known, Unknown };
+  std::array<uint8_t, MEMORY_SIZE> indexState = {};
+  std::array<uint16_t, MEMORY_SIZE> indexValue = {};
+  std::vector<uint16_t> work;
+  auto reach = [&](uint32_t pc, uint8_t state, uint16_t value) {
+    if (!image.fetchable(pc)) {
+      return;
+    }
+    uint8_t &current = indexState[pc];
+    if (current == Unvisited) {
+      current = state;
+      indexValue[pc] = value;
+    } else if (current == Known &&
+               (state == Unknown || indexValue[pc] != value)) {
+      current = Unknown;
+    } else {
+      return;
+    }
+    work.push_back(pc);
+  };
+
+  reach(ROM_START, Unknown, 0);
+  while (!work.empty()) {
+    const uint16_t pc = work.back();
+    work.pop_back();
+    const uint16_t op = image.at(pc);
+    const std::string name = pattern(op);
+    uint8_t state = indexState[pc];
+    uint16_t value = indexValue[pc];
+    const Use use = uses(op);
+    if (name == "ANNN") {
+      state = Known;
+      value = opNNN(op);
+    } else if (use.writesI) {
+      state = Unknown;
+    }
+
+    if (name.empty() || name == "0NNN" || name == "00EE" || name == "00FD") {
+      continue;
+    }
+    switch (opCode(op)) {
+      case 0x1:
+        reach(opNNN(op), state, value);
+        break;
+      case 0x2:
+        reach(opNNN(op), state, value);
+        // The subroutine may change I before it returns.
+        reach(pc + 2, Unknown, 0);
+        break;
+      case 0x3:
+      case 0x4:
+      case 0x5:
+      case 0x9:
+      case 0xE:
+        reach(pc + 2, state, value);
+        // On XO-CHIP a skip over F000 NNNN jumps the whole four bytes, so
+        // NNNN is never executed.
+        if (image.fetchable(pc + 2) && image.at(pc + 2) == 0xF000) {
+          reach(pc + 6, state, value);
+        } else {
+          reach(pc + 4, state, value);
+        }
+        break;
+      case 0xB:
+        // Only the V0 = 0 target is known; the rest are table entries.
+        reach(opNNN(op), state, value);
+        break;
+      default:
+        reach(pc + (op == 0xF000 ? 4 : 2), state, value);
+    }
+  }
+
+  std::array<bool, MEMORY_SIZE> code = {};
+  for (uint32_t pc = ROM_START; pc < image.end; ++pc) {
+    if (indexState[pc] != Unvisited) {
+      code[pc] = true;
+      code[pc + 1] = true;
+      // F000's address operand is part of the instruction.
+      if (image.at(pc) == 0xF000 && image.fetchable(pc + 2)) {
+        code[pc + 2] = true;
+        code[pc + 3] = true;
+      }
+    }
+  }
+  for (uint32_t pc = ROM_START; pc < image.end; ++pc) {
+    if (code[pc]) {
+      report.codeBytes++;
+      if (report.codeRanges.empty() ||
+          report.codeRanges.back().second != pc) {
+        report.codeRanges.push_back({pc, pc});
+      }
+      report.codeRanges.back().second = pc + 1;
+    }
+  }
+  report.dataBytes = rom.size() - report.codeBytes;
+
+  auto readsVF = [](const Use &use) { return (use.reads >> 0xF) & 1; };
+  auto writesVF = [](const Use &use) { return (use.writes >> 0xF) & 1; };
+  auto readsI = [](const Use &use) { return use.readsI; };
+  auto writesI = [](const Use &use) { return use.writesI; };
+
+  for (uint32_t pc = ROM_START; pc < image.end; ++pc) {
+    if (indexState[pc] == Unvisited) {
+      continue;
+    }
+    const uint16_t op = image.at(pc);
+    const std::string name = pattern(op);
+    report.instructions++;
+    if (listing) {
+      report.listing.push_back({pc, op});
+    }
+    if (name.empty()) {
+      report.invalid++;
+      report.opcodes["invalid"]++;
+      continue;
+    }
+    report.opcodes[name]++;
+    if (isExtension(name)) {
+      report.quirks["extensions"].push_back(pc);
+    }
+
+    if (name == "DXYN") {
+      report.spriteHeights[opN(op)]++;
+    } else if (name == "BNNN") {
+      report.computedJumps++;
+      if (opX(op) != 0) {
+        report.quirks["jump"].push_back(pc);
+      }
+    } else if ((name == "8XY6" || name == "8XYE") && opX(op) != opY(op)) {
+      report.quirks["shift"].push_back(pc);
+    } else if ((name == "8XY1" || name == "8XY2" || name == "8XY3") &&
+               readBeforeWrite(image, pc, readsVF, writesVF)) {
+      report.quirks["vf-reset"].push_back(pc);
+    }
+    if ((name == "FX55" || name == "FX65") &&
+        readBeforeWrite(image, pc, readsI, writesI)) {
+      report.quirks["memory"].push_back(pc);
+    }
+
+    if (name == "FX33" || name == "FX55") {
+      if (indexState[pc] != Known) {
+        report.unresolvedWrites++;
+        continue;
+      }
+      const MemoryAccess access = memoryAccess(op, indexValue[pc]);
+      for (uint32_t a = access.writeStart;
+           a < uint32_t(access.writeStart) + access.writeLength &&
+           a < MEMORY_SIZE;
+           ++a) {
+        if (code[a]) {
+          report.selfWrites.push_back(
+              {uint16_t(pc), op, access.writeStart, access.writeLength});
+          break;
+        }
+      }
+    }
+  }
+}
+
+bool readRom(const std::filesystem::path &path, std::vector<char> &rom) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  rom.assign(std::istreambuf_iterator<char>(in),
+             std::istreambuf_iterator<char>());
+  return true;
+}
+
+void scanRom(Report &report, const std::filesystem::path &root, bool listing) {
+  std::vector<char> rom;
+  if (!readRom(root / report.path, rom)) {
+    report.error = "cannot read ROM";
+    return;
+  }
+  report.size = rom.size();
+  if (rom.size() > MEMORY_SIZE - ROM_START) {
+    report.error = "ROM does not fit in memory";
+    return;
+  }
+  analyze(report, rom, listing);
+}
+
+std::string jsonString(const std::string &text) {
+  std::string out = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+std::string hexAddress(uint16_t address) {
+  char buf[8];
+  std::snprintf(buf, sizeof(buf), "\"%03X\"", address);
+  return buf;
+}
+
+void writeCounts(std::ostream &out,
+                 const std::map<std::string, uint64_t> &map) {
+  out << '{';
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    out << (it == map.begin() ? "" : ", ") << jsonString(it->first) << ": "
+        << it->second;
+  }
+  out << '}';
+}
+
+void writeHeights(std::ostream &out, const std::array<uint64_t, 16> &heights) {
+  std::map<std::string, uint64_t> used;
+  for (size_t n = 0; n < heights.size(); ++n) {
+    if (heights[n] > 0) {
+      used[n < 10 ? "0" + std::to_string(n) : std::to_string(n)] = heights[n];
+    }
+  }
+  writeCounts(out, used);
+}
+
+void writeReport(std::ostream &out, const Report &report) {
+  out << "    {\"path\": " << jsonString(report.path)
+      << ", \"size\": " << report.size;
+  if (!report.error.empty()) {
+    out << ", \"error\": " << jsonString(report.error) << '}';
+    return;
+  }
+  out << ", \"instructions\": " << report.instructions
+      << ", \"codeBytes\": " << report.codeBytes
+      << ", \"dataBytes\": " << report.dataBytes
+      << ", \"invalid\": " << report.invalid
+      << ", \"computedJumps\": " << report.computedJumps
+      << ",\n     \"code\": [";
+  for (size_t i = 0; i < report.codeRanges.size(); ++i) {
+    out << (i == 0 ? "" : ", ") << '[' << hexAddress(report.codeRanges[i].first)
+        << ", " << hexAddress(report.codeRanges[i].second - 1) << ']';
+  }
+  out << "],\n     \"opcodes\": ";
+  writeCounts(out, report.opcodes);
+  out << ",\n     \"spriteHeights\": ";
+  writeHeights(out, report.spriteHeights);
+  out << ",\n     \"selfModifying\": [";
+  for (size_t i = 0; i < report.selfWrites.size(); ++i) {
+    const SelfWrite &write = report.selfWrites[i];
+    char opcode[8];
+    std::snprintf(opcode, sizeof(opcode), "%04X", write.opcode);
+    out << (i == 0 ? "" : ", ") << "{\"pc\": " << hexAddress(write.pc)
+        << ", \"opcode\": \"" << opcode
+        << "\", \"target\": " << hexAddress(write.start)
+        << ", \"length\": " << write.length << '}';
+  }
+  out << "], \"unresolvedWrites\": " << report.unresolvedWrites
+      << ",\n     \"quirks\": {";
+  for (auto it = report.quirks.begin(); it != report.quirks.end(); ++it) {
+    out << (it == report.quirks.begin() ? "" : ", ") << jsonString(it->first)
+        << ": [";
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      out << (i == 0 ? "" : ", ") << hexAddress(it->second[i]);
+    }
+    out << ']';
+  }
+  out << '}';
+  if (!report.listing.empty()) {
+    out << ",\n     \"listing\": [";
+    for (size_t i = 0; i < report.listing.size(); ++i) {
+      char line[48];
+      std::snprintf(line, sizeof(line), "%03X: %04X  %s",
+                    report.listing[i].first, report.listing[i].second,
+                    mnemonic(report.listing[i].second).c_str());
+      out << (i == 0 ? "\n       " : ",\n       ") << jsonString(line);
+    }
+    out << ']';
+  }
+  out << '}';
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string romDirArg;
+  std::string outPath = "-";
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool listing = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.rfind("--rom-dir=", 0) == 0) {
+      romDirArg = arg.substr(10);
+    } else if (arg.rfind("--out=", 0) == 0) {
+      outPath = arg.substr(6);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::max(1, std::atoi(arg.c_str() + 10));
+    } else if (arg == "--listing") {
+      listing = true;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (romDirArg.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  const std::filesystem::path root(romDirArg);
+  std::vector<Report> reports;
+  std::error_code error;
+  for (auto it = std::filesystem::recursive_directory_iterator(
+           root, std::filesystem::directory_options::skip_permission_denied,
+           error);
+       !error && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error)) {
+    const std::string extension = it->path().extension().string();
+    if (it->is_regular_file() && (extension == ".ch8" || extension == ".c8")) {
+      Report report;
+      report.path = it->path().lexically_relative(root).generic_string();
+      reports.push_back(report);
+    }
+  }
+  if (error) {
+    std::cerr << "Cannot scan " << romDirArg << ": " << error.message()
+              << std::endl;
+    return 1;
+  }
+  std::sort(reports.begin(), reports.end(),
+            [](const Report &a, const Report &b) { return a.path < b.path; });
+
+  // ROMs are independent; workers pull the next one off a shared index.
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> nextReport{0};
+  auto worker = [&] {
+    for (size_t i = nextReport++; i < reports.size(); i = nextReport++) {
+      scanRom(reports[i], root, listing);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < std::min<size_t>(threads, reports.size()); ++t) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+  // Corpus totals: opcodes and sprite heights summed over the ROMs, the
+  // other counts are how many ROMs have at least one site.
+  std::map<std::string, uint64_t> opcodes;
+  std::array<uint64_t, 16> spriteHeights = {};
+  std::map<std::string, uint64_t> quirks;
+  uint64_t codeBytes = 0, dataBytes = 0, instructions = 0;
+  uint64_t selfModifying = 0, failed = 0;
+  for (const Report &report : reports) {
+    if (!report.error.empty()) {
+      failed++;
+      continue;
+    }
+    for (const auto &entry : report.opcodes) {
+      opcodes[entry.first] += entry.second;
+    }
+    for (size_t n = 0; n < spriteHeights.size(); ++n) {
+      spriteHeights[n] += report.spriteHeights[n];
+    }
+    for (const auto &entry : report.quirks) {
+      quirks[entry.first]++;
+    }
+    codeBytes += report.codeBytes;
+    dataBytes += report.dataBytes;
+    instructions += report.instructions;
+    selfModifying += report.selfWrites.empty() ? 0 : 1;
+  }
+
+  std::ofstream file;
+  if (outPath != "-") {
+    file.open(outPath);
+  }
+  std::ostream &out = outPath == "-" ? std::cout : file;
+  out << "{\n  \"roms\": " << reports.size() << ", \"failed\": " << failed
+      << ", \"seconds\": " << seconds << ",\n  \"totals\": {\"instructions\": "
+      << instructions << ", \"codeBytes\": " << codeBytes
+      << ", \"dataBytes\": " << dataBytes
+      << ", \"selfModifyingRoms\": " << selfModifying
+      << ",\n    \"opcodes\": ";
+  writeCounts(out, opcodes);
+  out << ",\n    \"spriteHeights\": ";
+  writeHeights(out, spriteHeights);
+  out << ",\n    \"quirkRoms\": ";
+  writeCounts(out, quirks);
+  out << "},\n  \"files\": [";
+  for (size_t i = 0; i < reports.size(); ++i) {
+    out << (i == 0 ? "\n" : ",\n");
+    writeReport(out, reports[i]);
+  }
+  out << "\n  ]\n}\n";
+  if (!out) {
+    std::cerr << "Cannot write report " << outPath << std::endl;
+    return 1;
+  }
+  if (outPath != "-") {
+    std::cerr << "Scanned " << reports.size() << " ROMs in " << seconds
+              << "s" << std::endl;
+  }
+  return 0;
+}
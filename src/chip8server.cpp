@@ -0,0 +1,85 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "components/components.hpp"
+#include "server/server.hpp"
+
+namespace {
+
+Server *activeServer = nullptr;
+
+void handleSignal(int) {
+  if (activeServer) {
+    activeServer->stop();
+  }
+}
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --rom=FILE [--listen=PORT|unix:PATH] [--ips=N]"
+               " [--shadow=N]\n"
+            << "Serves one emulator per connection; see server/server.hpp "
+               "for the protocol."
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string romPath;
+  std::string listen = "unix:/tmp/chip8.sock";
+  int instructionsPerSecond = 700;
+  long long shadowInterval = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.rfind("--rom=", 0) == 0) {
+      romPath = arg.substr(6);
+    } else if (arg.rfind("--listen=", 0) == 0) {
+      listen = arg.substr(9);
+    } else if (arg.rfind("--ips=", 0) == 0) {
+      instructionsPerSecond = std::atoi(arg.c_str() + 6);
+    } else if (arg.rfind("--shadow=", 0) == 0) {
+      shadowInterval = std::atoll(arg.c_str() + 9);
+      if (shadowInterval <= 0) {
+        printUsage(argv[0]);
+        return 1;
+      }
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (romPath.empty() || instructionsPerSecond <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  components::Memory loader;
+  std::vector<char> rom = loader.readBinaryFile(romPath);
+  if (!loader.loadIntoMemory(rom)) {
+    std::cerr << "ROM does not fit in memory: " << romPath << std::endl;
+    return 1;
+  }
+  Server server(std::move(rom), instructionsPerSecond, shadowInterval);
+
+  const bool listening = listen.rfind("unix:", 0) == 0
+                             ? server.listenUnix(listen.substr(5))
+                             : server.listenTcp(std::atoi(listen.c_str()));
+  if (!listening) {
+    std::cerr << "Cannot listen on " << listen << std::endl;
+    return 1;
+  }
+
+  activeServer = &server;
+  std::signal(SIGINT, handleSignal);
+  std::signal(SIGTERM, handleSignal);
+
+  std::cout << "Serving " << romPath << " on " << listen << std::endl;
+  server.run();
+  return 0;
+}
@@ -1,12 +1,12 @@
 #include "components.hpp"
 
-#include <SDL.h>
-
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <random>
 #include <vector>
 
 std::string uint8ToHex(uint8_t value) {
@@ -76,8 +76,24 @@ uint8_t translateKeyToChar(Key key) {
   }
 }
 
+const char *faultName(Fault fault) {
+  switch (fault) {
+  case Fault::None:
+    return "none";
+  case Fault::IllegalOpcode:
+    return "illegal opcode";
+  case Fault::StackOverflow:
+    return "stack overflow";
+  case Fault::StackUnderflow:
+    return "stack underflow";
+  case Fault::AddressOutOfRange:
+    return "address out of range";
+  }
+  return "unknown";
+}
+
 // From 000 to 1FF
-Memory::Memory() : mem(4096, 0) {
+Memory::Memory() : mem(MEMORY_SIZE, 0) {
   loadFonts();
   PC = 512;
 }
@@ -111,7 +127,7 @@ void Memory::setByte(const std::string &index, const std::string &value) {
 
 void Memory::setPC(uint16_t pc) { PC = pc; }
 
-uint16_t Memory::getPC() { return PC; }
+uint16_t Memory::getPC() const { return PC; }
 
 void Memory::print() {
   for (const auto byte : mem) {
@@ -155,7 +171,10 @@ void Memory::loadBinary(const std::string &directory) {
   }
 
   std::vector<char> binary = readBinaryFile(filepath);
-  loadIntoMemory(binary);
+  if (!loadIntoMemory(binary)) {
+    std::cerr << "ROM does not fit in memory: " << filepath << std::endl;
+    exit(1);
+  }
 }
 
 std::string
@@ -195,50 +214,48 @@ std::vector<char> Memory::readBinaryFile(const std::string &filepath) {
   return binary;
 }
 
-void Memory::loadIntoMemory(const std::vector<char> &binary) {
+bool Memory::loadIntoMemory(const std::vector<char> &binary) {
   auto pc = getPC();
+  if (pc + binary.size() > mem.size()) {
+    return false;
+  }
   for (auto byte : binary) {
     setByte(pc, byte);
     pc++;
   }
+  return true;
 }
 
 void Display::setPixel(const size_t row, const size_t col, bool val) {
-  matrix[row][col] = val;
+  const uint64_t mask = uint64_t(1) << (cols - 1 - col);
+  if (val) {
+    matrix[row] |= mask;
+  } else {
+    matrix[row] &= ~mask;
+  }
 }
 
 bool Display::getPixel(const size_t row, const size_t col) const {
-  return matrix[row][col];
+  return (matrix[row] >> (cols - 1 - col)) & 1;
 }
 
 void Display::protoPrint() {
-  for (const auto &row : matrix) {
-    for (bool valor : row) {
-      std::cout << (valor ? "█" : " ");
+  for (size_t row = 0; row < rows; ++row) {
+    for (size_t col = 0; col < cols; ++col) {
+      std::cout << (getPixel(row, col) ? "█" : " ");
     }
     std::cout << std::endl;
   }
 }
 
-void Display::setAllPixels(bool val) {
-  for (auto &row : matrix) {
-    for (bool &pixel : row) {
-      pixel = val;
-    }
-  }
-}
+void Display::setAllPixels(bool val) { matrix.fill(val ? ~uint64_t(0) : 0); }
 
 void Display::setReprint(bool val) { reprint = val; }
 
 bool Display::getReprint() { return reprint; }
 
 void Display::clear() {
-  char printable;
-  for (const auto &row : matrix) {
-    for (bool valor : row) {
-      valor = false;
-    }
-  }
+  setAllPixels(false);
   setReprint(true);
 }
 
@@ -246,6 +263,17 @@ size_t Display::getCols() const { return cols; }
 
 size_t Display::getRows() const { return rows; }
 
+const Display::Frame &Display::getFrame() const { return matrix; }
+
+uint64_t Display::getHash() const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint64_t row : matrix) {
+    hash = (hash ^ row) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
 Registers::Registers() : mem(16, 0) {}
 
 Registers::Registers(size_t size) : mem(size, 0) {}
@@ -264,62 +292,67 @@ uint8_t Registers::getReg(size_t reg) const {
   return mem[reg];
 }
 
-void Timer::start(int interval_ms, const std::string &timer_name) {
-  worker = std::thread([this, interval_ms, timer_name]() {
-    bool beepPlayed = false;
-    while (true) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
-
-      if (value.load() == 0 && beepPlayed) {
-        beepPlayed = false;
-      }
+void Timer::tick() {
+  if (value > 0) {
+    value--;
+  }
+}
 
-      if (value.load() > 0) {
-        value.store(value.load() - 1);
+uint8_t Timer::getValue() const { return value; }
+void Timer::setValue(uint8_t newValue) { value = newValue; }
 
-        if (beeper && !beepPlayed && value.load() > 0) {
-          playBeep();
-          beepPlayed = true;
-        }
-      }
+void Keypad::setKey(uint8_t key, bool pressed) {
+  if (key > 0xF) {
+    return;
+  }
+  const uint16_t mask = 1 << key;
+  if (pressed) {
+    state |= mask;
+  } else {
+    if (state & mask) {
+      released = key;
     }
-  });
-  worker.detach();
+    state &= ~mask;
+  }
 }
 
-uint8_t Timer::getValue() const { return value.load(); }
-void Timer::setValue(uint8_t newValue) { value.store(newValue); }
-
-void Timer::playBeep() {
-  const int SAMPLE_RATE = 44100;
-  const int FREQUENCY = 1000;
-  const int DURATION = 250;
-  const int NUM_SAMPLES = SAMPLE_RATE * DURATION / 1000;
-
-  SDL_AudioSpec spec;
-  SDL_zero(spec);
-  spec.freq = SAMPLE_RATE;
-  spec.format = AUDIO_S16SYS;
-  spec.channels = 1;
-  spec.samples = 2048;
-  spec.callback = nullptr;
-
-  if (SDL_OpenAudio(&spec, nullptr) < 0) {
-    std::cerr << "SDL_OpenAudio failed: " << SDL_GetError() << std::endl;
-    return;
+bool Keypad::isPressed(uint8_t key) const {
+  if (key > 0xF) {
+    return false;
   }
+  observed |= 1 << key;
+  return (state & (1 << key)) != 0;
+}
 
-  Sint16 *buffer = new Sint16[NUM_SAMPLES];
-  for (int i = 0; i < NUM_SAMPLES; ++i) {
-    double time = i / (double)SAMPLE_RATE;
-    buffer[i] = (Sint16)(32767 * sin(2 * M_PI * FREQUENCY * time));
-  }
+uint16_t Keypad::getState() const { return state; }
+
+uint8_t Keypad::takeReleasedKey() {
+  observed = 0xFFFF;
+  const uint8_t key = released;
+  released = 0xFF;
+  return key;
+}
+
+void Keypad::clearReleased() { released = 0xFF; }
 
-  SDL_QueueAudio(1, buffer, NUM_SAMPLES * sizeof(Sint16));
-  SDL_PauseAudio(0);
+uint16_t Keypad::takeObserved() {
+  const uint16_t keys = observed;
+  observed = 0;
+  return keys;
+}
+
+Rng::Rng() : Rng(std::random_device{}()) {}
 
-  SDL_Delay(DURATION);
+Rng::Rng(uint32_t seed) { this->seed(seed); }
+
+void Rng::seed(uint32_t seed) {
+  // xorshift must not start from zero.
+  state = seed ? seed : 0x9E3779B9u;
+}
 
-  SDL_CloseAudio();
-  delete[] buffer;
+uint8_t Rng::next() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state >> 24;
 }
@@ -54,6 +54,21 @@ uint8_t translateKeyToChar(Key key);
 
 std::string uint8ToHex(uint8_t value);
 
+const size_t MEMORY_SIZE = 4096;
+const size_t STACK_DEPTH = 16;
+
+// Reasons the interpreter can stop on a bad program. Handlers report these
+// instead of throwing so one broken ROM never takes the process down.
+enum class Fault {
+  None,
+  IllegalOpcode,
+  StackOverflow,
+  StackUnderflow,
+  AddressOutOfRange
+};
+
+const char *faultName(Fault fault);
+
 class Memory {
   std::vector<uint8_t> mem;
   uint16_t PC = 0;
@@ -66,24 +81,31 @@ public:
   void setByte(const size_t index, const std::string &value);
   void setByte(const std::string &index, const std::string &value);
   void setPC(uint16_t pc);
-  uint16_t getPC();
+  uint16_t getPC() const;
   void print();
   void printInHex();
   void loadBinary(const std::string &directory);
+  std::vector<char> readBinaryFile(const std::string &filepath);
+  // Copies a ROM at PC. Returns false, leaving memory untouched, if it does
+  // not fit.
+  bool loadIntoMemory(const std::vector<char> &binary);
 
 private:
   std::string findFirstBinaryFile(const std::string &directory,
                                   const std::vector<std::string> &extensions);
-  std::vector<char> readBinaryFile(const std::string &filepath);
-  void loadIntoMemory(const std::vector<char> &binary);
   size_t hexToIndex(const std::string &hexAddress) const;
   void loadFonts();
 };
 
 class Display {
+public:
   static const size_t rows = 32;
   static const size_t cols = 64;
-  std::array<std::array<bool, cols>, rows> matrix = {};
+  // One uint64_t per row, column 0 in the most significant bit.
+  using Frame = std::array<uint64_t, rows>;
+
+private:
+  Frame matrix = {};
   bool reprint = false;
 
 public:
@@ -96,6 +118,9 @@ public:
   void clear();
   size_t getRows() const;
   size_t getCols() const;
+  const Frame &getFrame() const;
+  // FNV-1a style hash of the framebuffer, for change detection.
+  uint64_t getHash() const;
 };
 
 class Registers {
@@ -108,19 +133,49 @@ public:
   uint8_t getReg(size_t reg) const;
 };
 
+// Counts down at 60 Hz of emulated time. The run loop calls tick() once per
+// frame, so timers stay constant while a frame's instructions execute.
 class Timer {
 public:
-  Timer(bool beeper) : beeper(beeper), value(255) {}
+  Timer() : value(255) {}
 
-  void start(int interval_ms, const std::string &timer_name);
+  void tick();
   uint8_t getValue() const;
   void setValue(uint8_t newValue);
-  void playBeep();
 
 private:
-  std::atomic<uint8_t> value;
-  std::thread worker;
-  bool beeper;
+  uint8_t value;
+};
+
+// State of the 16-key hex keypad as a bitmask (bit N set = key N held). The
+// host front-end feeds it from its input events between frames.
+class Keypad {
+  uint16_t state = 0;
+  uint8_t released = 0xFF;
+  // Keys the guest has looked at, for input latency measurements.
+  mutable uint16_t observed = 0;
+
+public:
+  void setKey(uint8_t key, bool pressed);
+  bool isPressed(uint8_t key) const;
+  uint16_t getState() const;
+  // Key released since the last clearReleased(), or 0xFF. Used by FX0A.
+  uint8_t takeReleasedKey();
+  void clearReleased();
+  // Keys read by EX9E/EXA1 (or all of them by FX0A) since the last call.
+  uint16_t takeObserved();
+};
+
+// xorshift32 generator behind CXNN. Each machine owns one, so a run can be
+// reproduced from its seed.
+class Rng {
+  uint32_t state;
+
+public:
+  Rng();
+  explicit Rng(uint32_t seed);
+  void seed(uint32_t seed);
+  uint8_t next();
 };
 
 #endif // components
@@ -1,7 +1,6 @@
 #include "cpu.hpp"
 
-#include <cstdlib>
-#include <iostream>
+#include <cstdio>
 
 uint16_t fetch(components::Memory &mem) {
   uint16_t pc = mem.getPC();
@@ -11,31 +10,57 @@ uint16_t fetch(components::Memory &mem) {
   return (static_cast<uint16_t>(highByte) << 8) | lowByte;
 }
 
-void decodeAndExecute(uint16_t instruction, components::Display &disp,
-                      components::Memory &mem, std::stack<uint16_t> &stack,
-                      components::Registers &variableRegs, uint16_t &indexReg,
-                      Timer &timerDelay, Timer &timerSound) {
-  uint8_t instCode = (instruction >> 12) & 0x0F;
-  switch (instCode) {
+MemoryAccess memoryAccess(uint16_t instruction, uint16_t indexReg) {
+  MemoryAccess access;
+  if (opCode(instruction) == 0xD) {
+    access.readStart = indexReg;
+    access.readLength = opN(instruction);
+  } else if (opCode(instruction) == 0xF) {
+    switch (opNN(instruction)) {
+      case 0x33:
+        access.writeStart = indexReg;
+        access.writeLength = 3;
+        break;
+      case 0x55:
+        access.writeStart = indexReg;
+        access.writeLength = opX(instruction) + 1;
+        break;
+      case 0x65:
+        access.readStart = indexReg;
+        access.readLength = opX(instruction) + 1;
+        break;
+    }
+  }
+  return access;
+}
+
+Fault decodeAndExecute(uint16_t instruction, components::Display &disp,
+                       components::Memory &mem, std::stack<uint16_t> &stack,
+                       components::Registers &variableRegs,
+                       uint16_t &indexReg, Timer &timerDelay,
+                       Timer &timerSound, components::Keypad &keypad,
+                       components::Rng &rng) {
+  switch (opCode(instruction)) {
     case 0x0:
-      if ((instruction & 0x00FF) == 0xE0) {
+      if (instruction == 0x00E0) {
         clearScreen(disp);
-      } else {
-        retFromSubroutine(mem, stack);
+        break;
       }
-      break;
+      if (instruction == 0x00EE) {
+        return retFromSubroutine(mem, stack);
+      }
+      // 0NNN machine code routines cannot run here.
+      return Fault::IllegalOpcode;
     case 0x1:
       jumpTo(instruction, mem);
       break;
     case 0x2:
-      callSubroutine(instruction, mem, stack);
-      break;
+      return callSubroutine(instruction, mem, stack);
     case 0x3:
     case 0x4:
     case 0x5:
     case 0x9:
-      conditional(instruction, variableRegs, mem);
-      break;
+      return conditional(instruction, variableRegs, mem);
     case 0x6:
       setRegister(instruction, variableRegs);
       break;
@@ -43,8 +68,7 @@ void decodeAndExecute(uint16_t instruction, components::Display &disp,
       addInRegister(instruction, variableRegs);
       break;
     case 0x8:
-      arithmetic(instruction, variableRegs);
-      break;
+      return arithmetic(instruction, variableRegs);
     case 0xA:
       setIndexRegister(instruction, indexReg);
       break;
@@ -52,20 +76,81 @@ void decodeAndExecute(uint16_t instruction, components::Display &disp,
       jumpOffset(instruction, variableRegs, mem);
       break;
     case 0xC:
-      random(instruction, variableRegs);
+      random(instruction, variableRegs, rng);
       break;
     case 0xD:
-      displaySprite(instruction, variableRegs, mem, disp, indexReg);
-      break;
+      return displaySprite(instruction, variableRegs, mem, disp, indexReg);
     case 0xE:
-      skipInst(instruction, variableRegs, mem);
-      break;
+      return skipInst(instruction, variableRegs, keypad, mem);
     case 0xF:
-      chooseFCodeFunc(instruction, variableRegs, mem, indexReg, timerDelay,
-                      timerSound);
+      return chooseFCodeFunc(instruction, variableRegs, mem, indexReg,
+                             timerDelay, timerSound, keypad);
+  }
+  return Fault::None;
+}
+
+Fault execute(Machine &machine, uint16_t instruction) {
+  return decodeAndExecute(instruction, machine.disp, machine.mem,
+                          machine.stack, machine.variableRegs,
+                          machine.indexReg, machine.timerDelay,
+                          machine.timerSound, machine.keypad, machine.rng);
+}
+
+bool step(Machine &machine, uint16_t &instruction) {
+  if (machine.fault != Fault::None) {
+    return false;
+  }
+  const uint16_t pc = machine.mem.getPC();
+  Fault fault = Fault::None;
+  if (pc >= MEMORY_SIZE - 1) {
+    fault = Fault::AddressOutOfRange;
+  } else {
+    instruction = fetch(machine.mem);
+    fault = execute(machine, instruction);
+  }
+  if (fault != Fault::None) {
+    machine.fault = fault;
+    machine.faultPC = pc;
+    machine.mem.setPC(pc);
+    return false;
+  }
+  return true;
+}
+
+bool step(Machine &machine) {
+  uint16_t instruction = 0;
+  return step(machine, instruction);
+}
+
+size_t runFrame(Machine &machine, size_t budget, IdleDetector &idle) {
+  idle.reset();
+  size_t executed = 0;
+  while (executed < budget) {
+    const uint16_t pc = machine.mem.getPC();
+    uint16_t instruction = 0;
+    if (!step(machine, instruction)) {
       break;
-    default:
-      std::cout << "Opcode does not exist." << std::endl;
-      exit(0);
+    }
+    ++executed;
+    executed += idle.observe(pc, instruction, machine, budget - executed);
+  }
+  return executed;
+}
+
+std::string describeFault(const Machine &machine) {
+  const uint16_t pc = machine.faultPC;
+  char buf[128];
+  if (pc < MEMORY_SIZE - 1) {
+    const unsigned opcode =
+        (machine.mem.getByte(pc) << 8) | machine.mem.getByte(pc + 1);
+    std::snprintf(buf, sizeof(buf),
+                  "%s at 0x%03X (opcode %04X, I=%03X, SP=%zu)",
+                  faultName(machine.fault), pc, opcode, machine.indexReg,
+                  machine.stack.size());
+  } else {
+    std::snprintf(buf, sizeof(buf), "%s at 0x%03X (I=%03X, SP=%zu)",
+                  faultName(machine.fault), pc, machine.indexReg,
+                  machine.stack.size());
   }
+  return buf;
 }
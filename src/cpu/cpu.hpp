@@ -1,14 +1,40 @@
 #ifndef CPU_HPP
 #define CPU_HPP
 
+#include <string>
+
 #include "../components/components.hpp"
 #include "../instructions/instructions.hpp"
+#include "decode.hpp"
+#include "idle.hpp"
+#include "machine.hpp"
 
 uint16_t fetch(components::Memory &mem);
 
-void decodeAndExecute(uint16_t instruction, components::Display &disp,
-                      components::Memory &mem, std::stack<uint16_t> &stack,
-                      components::Registers &variableRegs, uint16_t &indexReg,
-                      Timer &timerDelay, Timer &timerSound);
+// Returns the fault raised by the instruction, if any. A faulting
+// instruction leaves registers and memory as they were.
+Fault decodeAndExecute(uint16_t instruction, components::Display &disp,
+                       components::Memory &mem, std::stack<uint16_t> &stack,
+                       components::Registers &variableRegs,
+                       uint16_t &indexReg, Timer &timerDelay,
+                       Timer &timerSound, components::Keypad &keypad,
+                       components::Rng &rng);
+
+// decodeAndExecute() on the parts of a machine.
+Fault execute(Machine &machine, uint16_t instruction);
+
+// Fetches and executes a single instruction. On a fault it records it in
+// the machine, rewinds PC to the faulting instruction and returns false;
+// nothing runs again until machine.fault is cleared.
+bool step(Machine &machine, uint16_t &instruction);
+bool step(Machine &machine);
+
+// Runs one frame worth of instructions, fast-forwarding through idle loops.
+// Returns the number of instructions retired, skipped ones included. Stops
+// early if the machine faults.
+size_t runFrame(Machine &machine, size_t budget, IdleDetector &idle);
+
+// One-line report of the machine's current fault for logs and clients.
+std::string describeFault(const Machine &machine);
 
 #endif  // CPU_HPP
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef DECODE_HPP
+#define DECODE_HPP
+
+#include <cstdint>
+
+// Instruction field extraction shared by the decoder and the tools that
+// inspect guest code.
+inline uint8_t opCode(uint16_t instruction) {
+  return (instruction >> 12) & 0x0F;
+}
+inline uint8_t opX(uint16_t instruction) { return (instruction & 0x0F00) >> 8; }
+inline uint8_t opY(uint16_t instruction) { return (instruction & 0x00F0) >> 4; }
+inline uint8_t opN(uint16_t instruction) { return instruction & 0x000F; }
+inline uint8_t opNN(uint16_t instruction) { return instruction & 0x00FF; }
+inline uint16_t opNNN(uint16_t instruction) { return instruction & 0x0FFF; }
+
+// Data memory an instruction reads and writes, instruction fetch excluded.
+struct MemoryAccess {
+  uint16_t readStart = 0;
+  uint16_t readLength = 0;
+  uint16_t writeStart = 0;
+  uint16_t writeLength = 0;
+};
+
+MemoryAccess memoryAccess(uint16_t instruction, uint16_t indexReg);
+
+#endif  // DECODE_HPP
@@ -0,0 +1,271 @@
+#include "fusion.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+#include "../instructions/instructions.hpp"
+#include "cpu.hpp"
+
+namespace {
+
+// Executions of an address before the opcodes there are matched.
+const uint8_t HOT_EXECUTIONS = 32;
+// Longest form in bytes, minus one: a write this far before a form's first
+// byte can still change it.
+const uint16_t MAX_FORM_REACH = 5;
+const size_t PAIRS_REPORTED = 5;
+
+uint16_t wordAt(const components::Memory &mem, uint16_t address) {
+  return (mem.getByte(address) << 8) | mem.getByte(address + 1);
+}
+
+size_t formLength(FusedForm form) {
+  switch (form) {
+    case FusedForm::LoadDraw:
+    case FusedForm::CountLoop:
+      return 3;
+    case FusedForm::TableLoad:
+    case FusedForm::IndexDraw:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+const char *formPattern(FusedForm form) {
+  switch (form) {
+    case FusedForm::LoadDraw:
+      return "6XNN 6YNN DXYN";
+    case FusedForm::CountLoop:
+      return "7XNN 3XNN 1NNN";
+    case FusedForm::TableLoad:
+      return "ANNN FX65";
+    case FusedForm::IndexDraw:
+      return "ANNN DXYN";
+    default:
+      return "";
+  }
+}
+
+// Records a fault the way step() does.
+void raise(Machine &machine, Fault fault, uint16_t pc) {
+  machine.fault = fault;
+  machine.faultPC = pc;
+  machine.mem.setPC(pc);
+}
+
+// Runs the form starting at pc one constituent at a time through the
+// regular handlers, leaving PC, the idle detector and any fault where
+// step() would have. Returns false if it faulted.
+bool runForm(FusedForm form, uint16_t pc, Machine &machine,
+             IdleDetector &idle, size_t budget, size_t &executed,
+             Fuser &fuser) {
+  components::Memory &mem = machine.mem;
+  components::Registers &regs = machine.variableRegs;
+  auto retire = [&](uint16_t at, uint16_t instruction) {
+    ++executed;
+    executed += idle.observe(at, instruction, machine, budget - executed);
+  };
+
+  const uint16_t first = wordAt(mem, pc);
+  const uint16_t second = wordAt(mem, pc + 2);
+  switch (form) {
+    case FusedForm::LoadDraw: {
+      const uint16_t draw = wordAt(mem, pc + 4);
+      setRegister(first, regs);
+      retire(pc, first);
+      setRegister(second, regs);
+      retire(pc + 2, second);
+      mem.setPC(pc + 6);
+      const Fault fault =
+          displaySprite(draw, regs, mem, machine.disp, machine.indexReg);
+      if (fault != Fault::None) {
+        raise(machine, fault, pc + 4);
+        return false;
+      }
+      retire(pc + 4, draw);
+      fuser.countFused(form, 3);
+      return true;
+    }
+    case FusedForm::CountLoop: {
+      // 3XNN and 4XNN cannot fault. A loop that jumps back onto itself keeps
+      // going while whole iterations fit in the budget.
+      const uint16_t jump = wordAt(mem, pc + 4);
+      do {
+        addInRegister(first, regs);
+        retire(pc, first);
+        mem.setPC(pc + 4);
+        conditional(second, regs, mem);
+        retire(pc + 2, second);
+        if (mem.getPC() != pc + 4) {
+          fuser.countFused(form, 2);
+          break;
+        }
+        jumpTo(jump, mem);
+        retire(pc + 4, jump);
+        fuser.countFused(form, 3);
+      } while (opNNN(jump) == pc && executed + 3 <= budget);
+      return true;
+    }
+    case FusedForm::TableLoad:
+    case FusedForm::IndexDraw: {
+      setIndexRegister(first, machine.indexReg);
+      retire(pc, first);
+      mem.setPC(pc + 4);
+      const Fault fault =
+          form == FusedForm::TableLoad
+              ? loadFromMemory(second, regs, mem, machine.indexReg)
+              : displaySprite(second, regs, mem, machine.disp,
+                              machine.indexReg);
+      if (fault != Fault::None) {
+        raise(machine, fault, pc + 2);
+        return false;
+      }
+      retire(pc + 2, second);
+      fuser.countFused(form, 2);
+      return true;
+    }
+    default:
+      return true;
+  }
+}
+
+}  // namespace
+
+const char *fusedFormName(FusedForm form) {
+  switch (form) {
+    case FusedForm::LoadDraw:
+      return "load-draw";
+    case FusedForm::CountLoop:
+      return "count-loop";
+    case FusedForm::TableLoad:
+      return "table-load";
+    case FusedForm::IndexDraw:
+      return "index-draw";
+    default:
+      return "none";
+  }
+}
+
+void Fuser::reset() { *this = Fuser(); }
+
+FusedForm Fuser::match(uint16_t pc, const components::Memory &mem) const {
+  if (pc >= MEMORY_SIZE - 3) {
+    return FusedForm::None;
+  }
+  const uint16_t first = wordAt(mem, pc);
+  const uint16_t second = wordAt(mem, pc + 2);
+
+  if (pc < MEMORY_SIZE - 5) {
+    const uint16_t third = wordAt(mem, pc + 4);
+    if (opCode(first) == 0x6 && opCode(second) == 0x6 &&
+        opCode(third) == 0xD) {
+      return FusedForm::LoadDraw;
+    }
+    if (opCode(first) == 0x7 &&
+        (opCode(second) == 0x3 || opCode(second) == 0x4) &&
+        opX(first) == opX(second) && opCode(third) == 0x1) {
+      return FusedForm::CountLoop;
+    }
+  }
+  if (opCode(first) == 0xA && opCode(second) == 0xF &&
+      opNN(second) == 0x65) {
+    return FusedForm::TableLoad;
+  }
+  if (opCode(first) == 0xA && opCode(second) == 0xD) {
+    return FusedForm::IndexDraw;
+  }
+  return FusedForm::None;
+}
+
+FusedForm Fuser::lookup(uint16_t pc, const components::Memory &mem) {
+  if (pc >= MEMORY_SIZE) {
+    return FusedForm::None;
+  }
+  if (hits[pc] < HOT_EXECUTIONS && ++hits[pc] == HOT_EXECUTIONS) {
+    forms[pc] = match(pc, mem);
+  }
+  return forms[pc];
+}
+
+void Fuser::invalidate(uint16_t start, uint16_t length) {
+  const size_t from = start > MAX_FORM_REACH ? start - MAX_FORM_REACH : 0;
+  const size_t to = std::min<size_t>(size_t(start) + length, MEMORY_SIZE);
+  for (size_t address = from; address < to; ++address) {
+    hits[address] = 0;
+    forms[address] = FusedForm::None;
+  }
+}
+
+void Fuser::countFused(FusedForm form, size_t instructions) {
+  runs[size_t(form)]++;
+  fusedInstructions[size_t(form)] += instructions;
+  previous = -1;
+}
+
+void Fuser::countSingle(uint16_t instruction) {
+  const int current = opCode(instruction);
+  if (previous >= 0) {
+    pairs[(previous << 4) | current]++;
+  }
+  previous = current;
+  singleInstructions++;
+}
+
+void Fuser::report(std::ostream &out) const {
+  const uint64_t fused = std::accumulate(fusedInstructions.begin(),
+                                         fusedInstructions.end(), uint64_t(0));
+  out << "Fusion: " << fused << " of " << fused + singleInstructions
+      << " instructions ran fused" << std::endl;
+  for (size_t form = 1; form < runs.size(); ++form) {
+    out << "  " << std::left << std::setw(12)
+        << fusedFormName(FusedForm(form)) << std::setw(16)
+        << formPattern(FusedForm(form)) << std::right << std::setw(12)
+        << runs[form] << " runs " << std::setw(12) << fusedInstructions[form]
+        << " instructions" << std::endl;
+  }
+
+  std::array<uint8_t, 256> order;
+  std::iota(order.begin(), order.end(), 0);
+  std::partial_sort(order.begin(), order.begin() + PAIRS_REPORTED, order.end(),
+                    [&](uint8_t a, uint8_t b) { return pairs[a] > pairs[b]; });
+  out << "  hottest unfused pairs:";
+  for (size_t i = 0; i < PAIRS_REPORTED && pairs[order[i]] > 0; ++i) {
+    out << (i == 0 ? " " : ", ") << std::hex << std::uppercase
+        << (order[i] >> 4) << "xxx " << (order[i] & 0xF) << "xxx" << std::dec
+        << std::nouppercase << '=' << pairs[order[i]];
+  }
+  out << std::endl;
+}
+
+size_t runFrameFused(Machine &machine, size_t budget, IdleDetector &idle,
+                     Fuser &fuser) {
+  idle.reset();
+  size_t executed = 0;
+  while (executed < budget && machine.fault == Fault::None) {
+    const uint16_t pc = machine.mem.getPC();
+    const FusedForm form = fuser.lookup(pc, machine.mem);
+    if (form != FusedForm::None && executed + formLength(form) <= budget) {
+      if (!runForm(form, pc, machine, idle, budget, executed, fuser)) {
+        break;
+      }
+      continue;
+    }
+
+    // FX33 and FX55 address memory through I as it was before they ran.
+    const uint16_t indexReg = machine.indexReg;
+    uint16_t instruction = 0;
+    if (!step(machine, instruction)) {
+      break;
+    }
+    const MemoryAccess access = memoryAccess(instruction, indexReg);
+    if (access.writeLength > 0) {
+      fuser.invalidate(access.writeStart, access.writeLength);
+    }
+    fuser.countSingle(instruction);
+    ++executed;
+    executed += idle.observe(pc, instruction, machine, budget - executed);
+  }
+  return executed;
+}
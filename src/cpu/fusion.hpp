@@ -0,0 +1,67 @@
+#ifndef FUSION_HPP
+#define FUSION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "idle.hpp"
+#include "machine.hpp"
+
+// Opcode sequences that run as one handler.
+enum class FusedForm : uint8_t {
+  None,
+  LoadDraw,   // 6XNN 6YNN DXYN
+  CountLoop,  // 7XNN 3XNN|4XNN 1NNN, iterated while it jumps onto itself
+  TableLoad,  // ANNN FX65
+  IndexDraw,  // ANNN DXYN
+  Count
+};
+
+const char *fusedFormName(FusedForm form);
+
+// Peephole superinstructions. Every address keeps an execution count, and
+// once it is hot the opcodes starting there are matched against the fused
+// forms and the decision is cached. A fused form only ever starts at its
+// first address, so a skip or jump into the middle of a sequence runs the
+// remaining opcodes one at a time. Writes by FX33 and FX55 drop the cached
+// decisions around the written bytes.
+class Fuser {
+public:
+  // Forgets every decision, e.g. after memory changed from outside the
+  // machine.
+  void reset();
+
+  // The form to run at pc, counting the execution.
+  FusedForm lookup(uint16_t pc, const components::Memory &mem);
+  void invalidate(uint16_t start, uint16_t length);
+
+  void countFused(FusedForm form, size_t instructions);
+  // Records an instruction that ran on its own, for the pair profile.
+  void countSingle(uint16_t instruction);
+
+  // Executions per form and the hottest opcode pairs that still ran as
+  // single instructions, the candidates for the next fused form.
+  void report(std::ostream &out) const;
+
+private:
+  FusedForm match(uint16_t pc, const components::Memory &mem) const;
+
+  std::array<uint8_t, MEMORY_SIZE> hits = {};
+  std::array<FusedForm, MEMORY_SIZE> forms = {};
+  std::array<uint64_t, size_t(FusedForm::Count)> runs = {};
+  std::array<uint64_t, size_t(FusedForm::Count)> fusedInstructions = {};
+  // Unfused opcode pairs by leading nibble, previous << 4 | current.
+  std::array<uint64_t, 256> pairs = {};
+  int previous = -1;
+  uint64_t singleInstructions = 0;
+};
+
+// runFrame() with fused forms run as single handlers. Registers, memory,
+// display, faults and the idle detector see exactly what runFrame() would;
+// a form that does not fit in the remaining budget runs unfused.
+size_t runFrameFused(Machine &machine, size_t budget, IdleDetector &idle,
+                     Fuser &fuser);
+
+#endif  // FUSION_HPP
@@ -0,0 +1,87 @@
+#include "idle.hpp"
+
+#include "decode.hpp"
+
+bool isIdleSafe(uint16_t instruction) {
+  const uint8_t low = opNN(instruction);
+  switch (opCode(instruction)) {
+    case 0x0:
+      return low == 0xEE;
+    case 0xC:
+    case 0xD:
+    case 0xE:
+      return false;
+    case 0xF:
+      return low == 0x07 || low == 0x1E || low == 0x29 || low == 0x65;
+    default:
+      return true;
+  }
+}
+
+void IdleDetector::reset() {
+  armed = false;
+  idle = false;
+  sinceLast = 0;
+}
+
+IdleDetector::LoopState IdleDetector::capture(uint16_t head,
+                                              const Machine &machine) const {
+  LoopState state;
+  state.head = head;
+  state.indexReg = machine.indexReg;
+  state.stackDepth = machine.stack.size();
+  for (size_t reg = 0; reg < state.regs.size(); ++reg) {
+    state.regs[reg] = machine.variableRegs.getReg(reg);
+  }
+  return state;
+}
+
+size_t IdleDetector::observe(uint16_t pc, uint16_t instruction,
+                             const Machine &machine, size_t remaining) {
+  const uint8_t instCode = opCode(instruction);
+
+  // FX0A with no key released rewinds onto itself. Input only changes between
+  // frames, so the rest of the frame would re-execute it unchanged.
+  if (instCode == 0xF && opNN(instruction) == 0x0A &&
+      machine.mem.getPC() == pc) {
+    idle = true;
+    skipped += remaining;
+    return remaining;
+  }
+
+  if (!isIdleSafe(instruction) ||
+      (armed && machine.stack.size() < last.stackDepth)) {
+    // Side effect, or a return below the loop's frame that may depend on
+    // stack entries we do not compare.
+    armed = false;
+    return 0;
+  }
+
+  ++sinceLast;
+
+  const uint16_t target = opNNN(instruction);
+  if (instCode != 0x1 || target > pc) {
+    return 0;
+  }
+
+  LoopState current = capture(target, machine);
+  if (armed && current == last) {
+    // One full iteration brought the machine back to the same state, so the
+    // loop is a fixed point until the timers tick. Skip whole iterations only
+    // so the guest ends the frame exactly where it would have.
+    const size_t skip = (remaining / sinceLast) * sinceLast;
+    idle = true;
+    skipped += skip;
+    sinceLast = 0;
+    return skip;
+  }
+
+  last = current;
+  armed = true;
+  sinceLast = 0;
+  return 0;
+}
+
+bool IdleDetector::isIdle() const { return idle; }
+
+uint64_t IdleDetector::getSkipped() const { return skipped; }
@@ -0,0 +1,50 @@
+#ifndef IDLE_HPP
+#define IDLE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "machine.hpp"
+
+// Recognizes guest loops that spin without side effects, typically polling
+// the delay timer (FX07 / 3XNN / 1NNN). Timers only tick between frames, so
+// once such a loop returns to its head with identical state, every further
+// iteration in the current frame is a no-op and can be skipped.
+class IdleDetector {
+public:
+  // Must be called at the start of every frame, after the timers ticked.
+  void reset();
+
+  // Called after each executed instruction. Returns how many instructions of
+  // the remaining frame budget can be retired without executing them.
+  size_t observe(uint16_t pc, uint16_t instruction, const Machine &machine,
+                 size_t remaining);
+
+  bool isIdle() const;
+  uint64_t getSkipped() const;
+
+private:
+  struct LoopState {
+    uint16_t head = 0;
+    uint16_t indexReg = 0;
+    size_t stackDepth = 0;
+    std::array<uint8_t, 16> regs = {};
+
+    bool operator==(const LoopState &other) const = default;
+  };
+
+  LoopState capture(uint16_t head, const Machine &machine) const;
+
+  LoopState last;
+  bool armed = false;
+  bool idle = false;
+  size_t sinceLast = 0;
+  uint64_t skipped = 0;
+};
+
+// True for opcodes that neither write memory, the display or the timers nor
+// read input or the random generator.
+bool isIdleSafe(uint16_t instruction);
+
+#endif  // IDLE_HPP
@@ -0,0 +1,28 @@
+#ifndef MACHINE_HPP
+#define MACHINE_HPP
+
+#include <cstdint>
+#include <stack>
+
+#include "../components/components.hpp"
+
+// Complete state of one emulated CHIP-8. Everything the instruction handlers
+// touch lives here, so a front-end only has to own one of these.
+struct Machine {
+  components::Memory mem;
+  components::Display disp;
+  components::Registers variableRegs;
+  uint16_t indexReg = 0;
+  std::stack<uint16_t> stack;
+  components::Timer timerDelay;
+  components::Timer timerSound;
+  components::Keypad keypad;
+  components::Rng rng;
+  // Set when an instruction faults; the run loops stop until it is cleared.
+  // faultPC is the address of the offending instruction, which is also
+  // where PC is left.
+  Fault fault = Fault::None;
+  uint16_t faultPC = 0;
+};
+
+#endif  // MACHINE_HPP
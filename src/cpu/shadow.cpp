@@ -0,0 +1,220 @@
+#include "shadow.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "cpu.hpp"
+
+namespace {
+
+// Differing memory bytes listed in a report.
+const size_t MEMORY_DIFFS_REPORTED = 16;
+
+std::string hexRegisters(const Machine &machine) {
+  std::string out;
+  char byte[4];
+  for (uint8_t reg = 0; reg < 16; ++reg) {
+    std::snprintf(byte, sizeof(byte), "%02X",
+                  machine.variableRegs.getReg(reg));
+    out += byte;
+  }
+  return out;
+}
+
+std::string stackContents(const Machine &machine) {
+  std::vector<uint16_t> entries;
+  for (std::stack<uint16_t> stack = machine.stack; !stack.empty();
+       stack.pop()) {
+    entries.push_back(stack.top());
+  }
+  std::string out = "[";
+  char entry[8];
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    std::snprintf(entry, sizeof(entry), "%s%03X",
+                  it == entries.rbegin() ? "" : " ", *it);
+    out += entry;
+  }
+  return out + "]";
+}
+
+}  // namespace
+
+ShadowValidator::ShadowValidator(uint64_t interval, size_t history)
+    : interval(interval), sinceSample(interval), recent(history) {}
+
+void ShadowValidator::beginFrame(const Machine &machine) {
+  if (diverged) {
+    return;
+  }
+  if (interval == 0) {
+    if (synced) {
+      reference.keypad = machine.keypad;
+    } else {
+      reference = machine;
+      synced = true;
+    }
+    sampling = true;
+  } else if (sinceSample >= interval) {
+    reference = machine;
+    sampling = true;
+    sinceSample = 0;
+    recentCount = 0;
+  }
+}
+
+void ShadowValidator::replay(const Machine &machine, size_t executed) {
+  auto stepReference = [&] {
+    const uint16_t pc = reference.mem.getPC();
+    if (!recent.empty()) {
+      const uint16_t opcode = pc < MEMORY_SIZE - 1
+                                  ? (reference.mem.getByte(pc) << 8) |
+                                        reference.mem.getByte(pc + 1)
+                                  : 0;
+      recent[recentNext] = {pc, opcode};
+      recentNext = (recentNext + 1) % recent.size();
+      recentCount = std::min(recentCount + 1, recent.size());
+    }
+    return step(reference);
+  };
+  for (size_t i = 0; i < executed; ++i) {
+    if (!stepReference()) {
+      return;
+    }
+  }
+  // The fast path does not count the instruction that faulted.
+  if (machine.fault != Fault::None) {
+    stepReference();
+  }
+}
+
+bool ShadowValidator::endFrame(const Machine &machine, size_t executed) {
+  frames++;
+  if (diverged || !sampling) {
+    sinceSample += executed;
+    return !diverged;
+  }
+  sampling = false;
+  sinceSample += executed;
+
+  replay(machine, executed);
+  framesChecked++;
+  instructionsChecked += executed;
+
+  bool same = machine.mem.getPC() == reference.mem.getPC() &&
+              machine.indexReg == reference.indexReg &&
+              machine.stack == reference.stack &&
+              machine.timerDelay.getValue() ==
+                  reference.timerDelay.getValue() &&
+              machine.timerSound.getValue() ==
+                  reference.timerSound.getValue() &&
+              machine.disp.getFrame() == reference.disp.getFrame() &&
+              machine.fault == reference.fault &&
+              machine.faultPC == reference.faultPC;
+  for (uint8_t reg = 0; same && reg < 16; ++reg) {
+    same = machine.variableRegs.getReg(reg) ==
+           reference.variableRegs.getReg(reg);
+  }
+  for (size_t address = 0; same && address < MEMORY_SIZE; ++address) {
+    same = machine.mem.getByte(address) == reference.mem.getByte(address);
+  }
+
+  if (same) {
+    if (interval == 0) {
+      // Mirror the caller's end of frame so the next one starts equal.
+      reference.keypad.clearReleased();
+      reference.timerDelay.tick();
+      reference.timerSound.tick();
+    }
+    return true;
+  }
+  diverged = true;
+  report = describe(machine, executed);
+  return false;
+}
+
+std::string ShadowValidator::describe(const Machine &machine,
+                                      size_t executed) const {
+  char buf[160];
+  std::string out;
+  std::snprintf(buf, sizeof(buf),
+                "Shadow divergence in frame %llu (%s, %llu instructions "
+                "checked, %zu this frame):\n",
+                static_cast<unsigned long long>(frames),
+                interval == 0 ? "lockstep" : "sampled",
+                static_cast<unsigned long long>(instructionsChecked),
+                executed);
+  out += buf;
+  std::snprintf(buf, sizeof(buf), "  %-8s %-34s %s\n", "", "fast",
+                "reference");
+  out += buf;
+
+  auto row = [&](const char *name, const std::string &fast,
+                 const std::string &ref) {
+    std::snprintf(buf, sizeof(buf), "  %-8s %-34s %s%s\n", name, fast.c_str(),
+                  ref.c_str(), fast == ref ? "" : "  <--");
+    out += buf;
+  };
+  auto hex = [](unsigned value, int width) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%0*X", width, value);
+    return std::string(text);
+  };
+  auto hash = [](const Machine &m) {
+    char text[24];
+    std::snprintf(text, sizeof(text), "%016llx",
+                  static_cast<unsigned long long>(m.disp.getHash()));
+    return std::string(text);
+  };
+
+  row("pc", hex(machine.mem.getPC(), 3), hex(reference.mem.getPC(), 3));
+  row("i", hex(machine.indexReg, 3), hex(reference.indexReg, 3));
+  row("v0-vf", hexRegisters(machine), hexRegisters(reference));
+  row("stack", stackContents(machine), stackContents(reference));
+  row("dt st",
+      hex(machine.timerDelay.getValue(), 2) + " " +
+          hex(machine.timerSound.getValue(), 2),
+      hex(reference.timerDelay.getValue(), 2) + " " +
+          hex(reference.timerSound.getValue(), 2));
+  row("fault",
+      machine.fault == Fault::None ? "none" : describeFault(machine),
+      reference.fault == Fault::None ? "none" : describeFault(reference));
+  row("display", hash(machine), hash(reference));
+
+  size_t differing = 0;
+  std::string bytes;
+  for (size_t address = 0; address < MEMORY_SIZE; ++address) {
+    const uint8_t fast = machine.mem.getByte(address);
+    const uint8_t ref = reference.mem.getByte(address);
+    if (fast != ref) {
+      if (differing < MEMORY_DIFFS_REPORTED) {
+        std::snprintf(buf, sizeof(buf), " %03zX:%02X/%02X", address, fast,
+                      ref);
+        bytes += buf;
+      }
+      differing++;
+    }
+  }
+  std::snprintf(buf, sizeof(buf),
+                "  memory   %zu bytes differ (fast/reference)", differing);
+  out += buf + bytes + "\n";
+
+  out += "  last opcodes of the reference, oldest first:";
+  for (size_t i = 0; i < recentCount; ++i) {
+    const auto &entry =
+        recent[(recentNext + recent.size() - recentCount + i) % recent.size()];
+    std::snprintf(buf, sizeof(buf), "%s%03X:%04X", i % 8 == 0 ? "\n   " : " ",
+                  entry.first, entry.second);
+    out += buf;
+  }
+  return out + "\n";
+}
+
+bool ShadowValidator::hasDiverged() const { return diverged; }
+
+const std::string &ShadowValidator::getReport() const { return report; }
+
+uint64_t ShadowValidator::getFramesChecked() const { return framesChecked; }
+
+uint64_t ShadowValidator::getInstructionsChecked() const {
+  return instructionsChecked;
+}
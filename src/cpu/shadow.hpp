@@ -0,0 +1,61 @@
+#ifndef SHADOW_HPP
+#define SHADOW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "machine.hpp"
+
+// Checks a fast execution path (idle skipping, fused forms, VIP pacing)
+// against a reference machine that runs the same instructions one step() at
+// a time through the plain handlers. Frames are the sync points: the fast
+// path reports how many instructions it retired, the reference executes that
+// many, and the two states are compared in full (registers, stack, timers,
+// memory, framebuffer and fault).
+//
+// With an interval of 0 the reference runs in lockstep for the whole session
+// and only the keypad is copied across each frame. Otherwise a frame is
+// sampled once at least interval instructions went by since the last one:
+// the reference is forked from the machine before it and replays just that
+// frame, which costs one machine copy plus one frame of plain execution.
+class ShadowValidator {
+public:
+  // history is how many of the reference's last opcodes a report lists.
+  explicit ShadowValidator(uint64_t interval, size_t history = 32);
+
+  // Called right before the fast path runs a frame.
+  void beginFrame(const Machine &machine);
+  // Called right after it, before the timers tick. Returns false on the
+  // first divergence; getReport() then describes it and checking stops.
+  bool endFrame(const Machine &machine, size_t executed);
+
+  bool hasDiverged() const;
+  const std::string &getReport() const;
+  uint64_t getFramesChecked() const;
+  uint64_t getInstructionsChecked() const;
+
+private:
+  void replay(const Machine &machine, size_t executed);
+  std::string describe(const Machine &machine, size_t executed) const;
+
+  uint64_t interval;
+  Machine reference;
+  bool synced = false;
+  bool sampling = false;
+  uint64_t sinceSample = 0;
+  bool diverged = false;
+  std::string report;
+  uint64_t frames = 0;
+  uint64_t framesChecked = 0;
+  uint64_t instructionsChecked = 0;
+
+  // (pc, opcode) ring of the reference's most recent instructions.
+  std::vector<std::pair<uint16_t, uint16_t>> recent;
+  size_t recentNext = 0;
+  size_t recentCount = 0;
+};
+
+#endif  // SHADOW_HPP
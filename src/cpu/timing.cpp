@@ -0,0 +1,149 @@
+#include "timing.hpp"
+
+#include "cpu.hpp"
+#include "decode.hpp"
+
+namespace {
+
+// Fetching and dispatching an instruction costs the same for every opcode.
+const uint32_t FETCH_CYCLES = 40;
+const int64_t FRAME_BUDGET = VIP_CYCLES_PER_FRAME - VIP_INTERRUPT_CYCLES;
+
+uint32_t skipCycles(bool taken, uint32_t base) {
+  return taken ? base + 4 : base;
+}
+
+uint32_t spriteCycles(uint16_t instruction, const Machine &machine) {
+  const uint8_t shift = machine.variableRegs.getReg(opX(instruction)) & 7;
+  const uint8_t rows = opN(instruction);
+  // Each row is shifted bit by bit into two bytes when the sprite is not
+  // byte-aligned, then XORed into display memory.
+  const uint32_t perRow = shift == 0 ? 34 : 50 + 4 * shift;
+  return 26 + rows * perRow;
+}
+
+uint32_t bcdCycles(uint8_t value) {
+  // The digits are found by repeated subtraction.
+  const uint32_t digits = value / 100 + (value / 10) % 10 + value % 10;
+  return 80 + 16 * digits;
+}
+
+}  // namespace
+
+uint32_t vipCycles(uint16_t instruction, const Machine &machine) {
+  const components::Registers &regs = machine.variableRegs;
+  const uint8_t vx = regs.getReg(opX(instruction));
+  const uint8_t vy = regs.getReg(opY(instruction));
+  uint32_t cost = 0;
+  switch (opCode(instruction)) {
+    case 0x0:
+      // 00E0 zeroes the 256 bytes of display memory one at a time.
+      cost = instruction == 0x00E0 ? 3078 : 10;
+      break;
+    case 0x1:
+      cost = 12;
+      break;
+    case 0x2:
+      cost = 26;
+      break;
+    case 0x3:
+      cost = skipCycles(vx == opNN(instruction), 10);
+      break;
+    case 0x4:
+      cost = skipCycles(vx != opNN(instruction), 10);
+      break;
+    case 0x5:
+      cost = skipCycles(vx == vy, 14);
+      break;
+    case 0x6:
+      cost = 6;
+      break;
+    case 0x7:
+      cost = 10;
+      break;
+    case 0x8:
+      cost = opN(instruction) == 0 ? 12 : 44;
+      break;
+    case 0x9:
+      cost = skipCycles(vx != vy, 14);
+      break;
+    case 0xA:
+      cost = 12;
+      break;
+    case 0xB: {
+      // Crossing a page costs an extra carry into the high byte.
+      const uint16_t target = opNNN(instruction) + regs.getReg(0);
+      cost = (target >> 8) != (opNNN(instruction) >> 8) ? 24 : 22;
+      break;
+    }
+    case 0xC:
+      cost = 36;
+      break;
+    case 0xD:
+      cost = spriteCycles(instruction, machine);
+      break;
+    case 0xE: {
+      const bool pressed = machine.keypad.isPressed(vx);
+      cost = skipCycles(opNN(instruction) == 0x9E ? pressed : !pressed, 14);
+      break;
+    }
+    case 0xF:
+      switch (opNN(instruction)) {
+        case 0x0A:
+          cost = 18;
+          break;
+        case 0x1E:
+        case 0x29:
+          cost = 16;
+          break;
+        case 0x33:
+          cost = bcdCycles(vx);
+          break;
+        case 0x55:
+        case 0x65:
+          cost = 14 + 14 * (opX(instruction) + 1);
+          break;
+        default:
+          cost = 10;
+          break;
+      }
+      break;
+  }
+  return FETCH_CYCLES + cost;
+}
+
+size_t VipTiming::runFrame(Machine &machine) {
+  balance += FRAME_BUDGET;
+  frames++;
+  size_t executed = 0;
+  while (balance > 0) {
+    const uint16_t pc = machine.mem.getPC();
+    if (pc >= MEMORY_SIZE - 1) {
+      // Let step() raise the fault.
+      step(machine);
+      break;
+    }
+    const uint16_t instruction =
+        (machine.mem.getByte(pc) << 8) | machine.mem.getByte(pc + 1);
+    if (opCode(instruction) == 0xD && executed > 0) {
+      // Display wait: the rest of the frame is spent waiting for vblank.
+      balance = 0;
+      break;
+    }
+    const uint32_t cost = vipCycles(instruction, machine);
+    if (!step(machine)) {
+      break;
+    }
+    balance -= cost;
+    cycles += cost;
+    ++executed;
+  }
+  instructions += executed;
+  return executed;
+}
+
+uint64_t VipTiming::getCycles() const { return cycles; }
+
+uint64_t VipTiming::getFrames() const { return frames; }
+
+uint64_t VipTiming::getInstructions() const { return instructions; }
@@ -0,0 +1,45 @@
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "machine.hpp"
+
+// COSMAC VIP timing. Costs are in 1802 machine cycles (8 clocks of the
+// 1.7609 MHz crystal). A 60 Hz frame is 3668 of them, of which the display
+// interrupt and the 1861's DMA take a fixed share before the interpreter
+// gets the rest.
+const uint32_t VIP_CYCLES_PER_FRAME = 3668;
+const uint32_t VIP_INTERRUPT_CYCLES = 1122;
+
+// Cycles the VIP interpreter spends on instruction, fetch and decode
+// included, given the machine state right before it executes. Conditional
+// skips, DXYN, BNNN and FX33 depend on that state.
+uint32_t vipCycles(uint16_t instruction, const Machine &machine);
+
+// Schedules a machine by VIP cycle counts instead of a fixed number of
+// instructions per frame. Cycles left over or overdrawn at the end of a frame
+// carry into the next one, so long instructions such as 00E0 stall the
+// following frame just like on hardware.
+class VipTiming {
+public:
+  // Runs one 60 Hz frame. DXYN waits for vertical blank the way the VIP
+  // interpreter does: a draw that is not the first instruction of the frame
+  // ends it, and runs at the start of the next one. Returns the number of
+  // instructions executed.
+  size_t runFrame(Machine &machine);
+
+  // Cycles spent executing instructions, interrupts excluded.
+  uint64_t getCycles() const;
+  uint64_t getFrames() const;
+  uint64_t getInstructions() const;
+
+private:
+  int64_t balance = 0;
+  uint64_t cycles = 0;
+  uint64_t frames = 0;
+  uint64_t instructions = 0;
+};
+
+#endif  // TIMING_HPP
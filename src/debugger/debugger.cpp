@@ -0,0 +1,112 @@
+#include "debugger.hpp"
+
+#include "../cpu/cpu.hpp"
+
+void Debugger::setBreakpoint(uint16_t address, bool enabled) {
+  if (address < addressSpace) {
+    breakpoints[address] = enabled;
+  }
+}
+
+void Debugger::setWatch(uint16_t address, size_t length, bool read,
+                        bool write, bool enabled) {
+  for (size_t i = address; i < address + length && i < addressSpace; ++i) {
+    if (read) {
+      readWatch[i] = enabled;
+    }
+    if (write) {
+      writeWatch[i] = enabled;
+    }
+  }
+}
+
+void Debugger::clearAll() {
+  breakpoints.reset();
+  readWatch.reset();
+  writeWatch.reset();
+}
+
+void Debugger::halt(StopReason stopReason, uint16_t address) {
+  halted = true;
+  stepping = false;
+  reason = stopReason;
+  stopAddress = address;
+}
+
+void Debugger::resume() {
+  halted = false;
+  stepping = false;
+  reason = StopReason::None;
+  resumeFrom = -2;  // Resolved to the PC by the next checkBreakpoint().
+}
+
+void Debugger::step() {
+  resume();
+  stepping = true;
+}
+
+bool Debugger::isHalted() const { return halted; }
+
+StopReason Debugger::getStopReason() const { return reason; }
+
+uint16_t Debugger::getStopAddress() const { return stopAddress; }
+
+bool Debugger::checkBreakpoint(uint16_t pc) {
+  if (resumeFrom == -2) {
+    resumeFrom = pc;
+  }
+  if (pc < addressSpace && breakpoints[pc] && resumeFrom != pc) {
+    halt(StopReason::Breakpoint, pc);
+    return true;
+  }
+  resumeFrom = -1;
+  return false;
+}
+
+bool Debugger::watched(const std::bitset<addressSpace> &bits, uint16_t start,
+                       uint16_t length, uint16_t &hit) const {
+  for (size_t i = start; i < size_t(start) + length && i < addressSpace; ++i) {
+    if (bits[i]) {
+      hit = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Debugger::checkAfter(uint16_t instruction, uint16_t indexReg) {
+  const MemoryAccess access = memoryAccess(instruction, indexReg);
+  uint16_t hit = 0;
+  if (watched(writeWatch, access.writeStart, access.writeLength, hit)) {
+    halt(StopReason::WriteWatch, hit);
+    return true;
+  }
+  if (watched(readWatch, access.readStart, access.readLength, hit)) {
+    halt(StopReason::ReadWatch, hit);
+    return true;
+  }
+  if (stepping) {
+    halt(StopReason::Step);
+    return true;
+  }
+  return false;
+}
+
+size_t runFrameDebug(Machine &machine, size_t budget, Debugger &debugger) {
+  size_t executed = 0;
+  while (executed < budget && !debugger.isHalted()) {
+    if (debugger.checkBreakpoint(machine.mem.getPC())) {
+      break;
+    }
+    // The access range depends on I before the instruction runs.
+    const uint16_t indexReg = machine.indexReg;
+    uint16_t instruction = 0;
+    if (!step(machine, instruction)) {
+      debugger.halt(StopReason::Fault, machine.faultPC);
+      break;
+    }
+    ++executed;
+    debugger.checkAfter(instruction, indexReg);
+  }
+  return executed;
+}
@@ -0,0 +1,68 @@
+#ifndef DEBUGGER_HPP
+#define DEBUGGER_HPP
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#include "../cpu/machine.hpp"
+
+enum class StopReason {
+  None,
+  Breakpoint,
+  ReadWatch,
+  WriteWatch,
+  Step,
+  Interrupt,
+  Fault
+};
+
+// Breakpoints and memory watchpoints as bitmaps over the 4 KiB address space.
+// They are only consulted by runFrameDebug(); the regular runFrame() never
+// looks at them, so the release path pays nothing for the debugger.
+class Debugger {
+public:
+  static const size_t addressSpace = 4096;
+
+  void setBreakpoint(uint16_t address, bool enabled);
+  void setWatch(uint16_t address, size_t length, bool read, bool write,
+                bool enabled);
+  void clearAll();
+
+  void halt(StopReason reason, uint16_t address = 0);
+  void resume();
+  // Resumes for exactly one instruction.
+  void step();
+  bool isHalted() const;
+  StopReason getStopReason() const;
+  // Data address that triggered a watchpoint stop.
+  uint16_t getStopAddress() const;
+
+  // Called before executing the instruction at pc; halts on a breakpoint.
+  bool checkBreakpoint(uint16_t pc);
+  // Called after executing an instruction with its data access computed
+  // beforehand; halts on a watchpoint hit or at the end of a single step.
+  bool checkAfter(uint16_t instruction, uint16_t indexReg);
+
+private:
+  bool watched(const std::bitset<addressSpace> &bits, uint16_t start,
+               uint16_t length, uint16_t &hit) const;
+
+  std::bitset<addressSpace> breakpoints;
+  std::bitset<addressSpace> readWatch;
+  std::bitset<addressSpace> writeWatch;
+  bool halted = false;
+  bool stepping = false;
+  // Address resumed from, so its breakpoint does not fire again at once.
+  int resumeFrom = -1;
+  StopReason reason = StopReason::None;
+  uint16_t stopAddress = 0;
+};
+
+// Debug-mode counterpart of runFrame(): checks breakpoints and watchpoints
+// around every instruction and returns early when the debugger halts. Idle
+// loops are not skipped so that breakpoints inside them still fire. A fault
+// halts the debugger at the faulting instruction.
+size_t runFrameDebug(Machine &machine, size_t budget, Debugger &debugger);
+
+#endif  // DEBUGGER_HPP
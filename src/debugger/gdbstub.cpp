@@ -0,0 +1,542 @@
+#include "gdbstub.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const size_t REG_I = 16;
+const size_t REG_PC = 17;
+const size_t REG_SP = 18;
+const size_t REG_DT = 19;
+const size_t REG_ST = 20;
+const size_t REG_COUNT = 21;
+
+const char *const TARGET_XML =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><feature name=\"org.chip8.core\">"
+    "<reg name=\"v0\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>"
+    "<reg name=\"v1\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v2\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v3\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v4\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v5\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v6\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v7\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v8\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v9\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"va\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vb\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vc\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vd\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"ve\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vf\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"dt\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"st\" bitsize=\"8\" type=\"uint8\"/>"
+    "</feature></target>";
+
+size_t registerSize(size_t index) {
+  return index == REG_I || index == REG_PC ? 2 : 1;
+}
+
+std::string toHex(uint32_t value, size_t bytes) {
+  // Little-endian, as GDB expects register contents in target byte order.
+  std::string out;
+  char buf[3];
+  for (size_t i = 0; i < bytes; ++i) {
+    std::snprintf(buf, sizeof(buf), "%02x", (value >> (8 * i)) & 0xFF);
+    out += buf;
+  }
+  return out;
+}
+
+bool fromHex(const std::string &hex, size_t offset, size_t bytes,
+             uint32_t &value) {
+  if (offset + 2 * bytes > hex.size()) {
+    return false;
+  }
+  value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    const std::string byte = hex.substr(offset + 2 * i, 2);
+    char *end = nullptr;
+    const unsigned long parsed = std::strtoul(byte.c_str(), &end, 16);
+    if (*end != '\0') {
+      return false;
+    }
+    value |= parsed << (8 * i);
+  }
+  return true;
+}
+
+// Parses "addr,length" (both hex) at the start of args.
+bool parseRange(const std::string &args, size_t &address, size_t &length,
+                size_t &consumed) {
+  char *end = nullptr;
+  address = std::strtoul(args.c_str(), &end, 16);
+  if (*end != ',') {
+    return false;
+  }
+  length = std::strtoul(end + 1, &end, 16);
+  consumed = end - args.c_str();
+  return true;
+}
+
+void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+}  // namespace
+
+GdbStub::GdbStub(Debugger &debugger) : debugger(debugger) {}
+
+GdbStub::~GdbStub() {
+  closeClient();
+  if (listenFd >= 0) {
+    close(listenFd);
+  }
+  if (!unixPath.empty()) {
+    unlink(unixPath.c_str());
+  }
+}
+
+bool GdbStub::listenTcp(int port) {
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return false;
+  }
+  const int yes = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(listenFd, 1) < 0) {
+    std::cerr << "GDB stub cannot listen on port " << port << ": "
+              << std::strerror(errno) << std::endl;
+    close(listenFd);
+    listenFd = -1;
+    return false;
+  }
+  setNonBlocking(listenFd);
+  return true;
+}
+
+bool GdbStub::listenUnix(const std::string &path) {
+  sockaddr_un addr = {};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return false;
+  }
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(listenFd, 1) < 0) {
+    std::cerr << "GDB stub cannot listen on " << path << ": "
+              << std::strerror(errno) << std::endl;
+    close(listenFd);
+    listenFd = -1;
+    return false;
+  }
+  unixPath = path;
+  setNonBlocking(listenFd);
+  return true;
+}
+
+bool GdbStub::wantsQuit() const { return quit; }
+
+void GdbStub::acceptClient() {
+  clientFd = accept(listenFd, nullptr, nullptr);
+  if (clientFd < 0) {
+    return;
+  }
+  setNonBlocking(clientFd);
+  input.clear();
+  awaitingStop = false;
+  // GDB expects the target to be stopped when it attaches.
+  debugger.halt(StopReason::Interrupt);
+}
+
+void GdbStub::closeClient() {
+  if (clientFd >= 0) {
+    close(clientFd);
+    clientFd = -1;
+  }
+  input.clear();
+  awaitingStop = false;
+}
+
+bool GdbStub::readInput(int timeoutMs) {
+  pollfd pfd = {clientFd, POLLIN, 0};
+  if (::poll(&pfd, 1, timeoutMs) <= 0) {
+    return false;
+  }
+  char buf[4096];
+  const ssize_t n = recv(clientFd, buf, sizeof(buf), 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+    // Client went away: drop its breakpoints and let the machine run.
+    closeClient();
+    debugger.clearAll();
+    debugger.resume();
+    return false;
+  }
+  if (n > 0) {
+    input.append(buf, n);
+  }
+  return n > 0;
+}
+
+void GdbStub::poll(Machine &machine) {
+  if (listenFd < 0) {
+    return;
+  }
+  if (clientFd < 0) {
+    acceptClient();
+    if (clientFd < 0) {
+      return;
+    }
+  }
+
+  readInput(0);
+  processInput(machine);
+
+  // Serve follow-up packets while halted so stepping is not throttled by
+  // the frame rate.
+  while (clientFd >= 0 && debugger.isHalted() && readInput(5)) {
+    processInput(machine);
+  }
+}
+
+void GdbStub::processInput(Machine &machine) {
+  while (!input.empty() && clientFd >= 0) {
+    const char c = input[0];
+    if (c == '\x03') {
+      input.erase(0, 1);
+      if (!debugger.isHalted()) {
+        debugger.halt(StopReason::Interrupt);
+      }
+      continue;
+    }
+    if (c != '$') {
+      // Acks ('+' / '-') and noise between packets.
+      input.erase(0, 1);
+      continue;
+    }
+
+    const size_t hash = input.find('#');
+    if (hash == std::string::npos || hash + 2 >= input.size()) {
+      break;  // Incomplete packet.
+    }
+    const std::string payload = input.substr(1, hash - 1);
+    const unsigned expected =
+        std::strtoul(input.substr(hash + 1, 2).c_str(), nullptr, 16);
+    input.erase(0, hash + 3);
+
+    uint8_t sum = 0;
+    for (char p : payload) {
+      sum += static_cast<uint8_t>(p);
+    }
+    if (sum != expected) {
+      send(clientFd, "-", 1, MSG_NOSIGNAL);
+      continue;
+    }
+    send(clientFd, "+", 1, MSG_NOSIGNAL);
+    handlePacket(payload, machine);
+  }
+
+  if (clientFd >= 0 && awaitingStop && debugger.isHalted()) {
+    awaitingStop = false;
+    sendPacket(stopReply(machine));
+  }
+}
+
+std::string GdbStub::stopReply(const Machine &machine) const {
+  char buf[32];
+  switch (debugger.getStopReason()) {
+    case StopReason::WriteWatch:
+      std::snprintf(buf, sizeof(buf), "T05watch:%x;",
+                    debugger.getStopAddress());
+      return buf;
+    case StopReason::ReadWatch:
+      std::snprintf(buf, sizeof(buf), "T05rwatch:%x;",
+                    debugger.getStopAddress());
+      return buf;
+    case StopReason::Interrupt:
+      return "S02";
+    case StopReason::Fault:
+      // SIGILL for bad opcodes, SIGSEGV for stack and memory faults.
+      return machine.fault == Fault::IllegalOpcode ? "S04" : "S0b";
+    default:
+      return "S05";
+  }
+}
+
+void GdbStub::handlePacket(const std::string &packet, Machine &machine) {
+  const char command = packet.empty() ? '\0' : packet[0];
+  const std::string args = packet.size() > 1 ? packet.substr(1) : "";
+
+  switch (command) {
+    case '?':
+      sendPacket(stopReply(machine));
+      return;
+    case 'g':
+      sendPacket(readRegisters(machine));
+      return;
+    case 'G':
+      writeRegisters(args, machine);
+      sendPacket("OK");
+      return;
+    case 'p':
+      sendPacket(
+          readRegister(std::strtoul(args.c_str(), nullptr, 16), machine));
+      return;
+    case 'P': {
+      const size_t eq = args.find('=');
+      const bool ok =
+          eq != std::string::npos &&
+          writeRegister(std::strtoul(args.c_str(), nullptr, 16),
+                        args.substr(eq + 1), machine);
+      sendPacket(ok ? "OK" : "E01");
+      return;
+    }
+    case 'm':
+      sendPacket(readMemory(args, machine));
+      return;
+    case 'M':
+      sendPacket(writeMemory(args, machine));
+      return;
+    case 'c':
+      // Continuing re-executes a faulting instruction, so a fault only
+      // clears for good once GDB has moved PC or fixed the state.
+      machine.fault = Fault::None;
+      debugger.resume();
+      awaitingStop = true;
+      return;
+    case 's':
+      machine.fault = Fault::None;
+      debugger.step();
+      awaitingStop = true;
+      return;
+    case 'Z':
+    case 'z':
+      sendPacket(setPoint(args, command == 'Z'));
+      return;
+    case 'H':
+    case 'T':
+      sendPacket("OK");
+      return;
+    case 'D':
+      debugger.clearAll();
+      debugger.resume();
+      sendPacket("OK");
+      closeClient();
+      return;
+    case 'k':
+      quit = true;
+      closeClient();
+      return;
+    case 'q':
+      if (packet.rfind("qSupported", 0) == 0) {
+        sendPacket("PacketSize=1000;qXfer:features:read+");
+      } else if (packet == "qAttached") {
+        sendPacket("1");
+      } else if (packet == "qC") {
+        sendPacket("QC1");
+      } else if (packet == "qfThreadInfo") {
+        sendPacket("m1");
+      } else if (packet == "qsThreadInfo") {
+        sendPacket("l");
+      } else if (packet.rfind("qXfer:features:read:target.xml:", 0) == 0) {
+        size_t offset = 0, length = 0, consumed = 0;
+        const std::string range = packet.substr(31);
+        if (!parseRange(range, offset, length, consumed)) {
+          sendPacket("E01");
+          return;
+        }
+        const std::string xml = TARGET_XML;
+        if (offset >= xml.size()) {
+          sendPacket("l");
+        } else {
+          const std::string chunk = xml.substr(offset, length);
+          sendPacket((offset + chunk.size() < xml.size() ? "m" : "l") + chunk);
+        }
+      } else {
+        sendPacket("");
+      }
+      return;
+    default:
+      sendPacket("");
+      return;
+  }
+}
+
+std::string GdbStub::readRegister(size_t index, const Machine &machine) const {
+  uint32_t value = 0;
+  if (index < 16) {
+    value = machine.variableRegs.getReg(index);
+  } else if (index == REG_I) {
+    value = machine.indexReg;
+  } else if (index == REG_PC) {
+    value = machine.mem.getPC();
+  } else if (index == REG_SP) {
+    value = machine.stack.size();
+  } else if (index == REG_DT) {
+    value = machine.timerDelay.getValue();
+  } else if (index == REG_ST) {
+    value = machine.timerSound.getValue();
+  } else {
+    return "E01";
+  }
+  return toHex(value, registerSize(index));
+}
+
+bool GdbStub::writeRegister(size_t index, const std::string &hex,
+                            Machine &machine) {
+  uint32_t value = 0;
+  if (index >= REG_COUNT || !fromHex(hex, 0, registerSize(index), value)) {
+    return false;
+  }
+  if (index < 16) {
+    machine.variableRegs.setReg(index, value);
+  } else if (index == REG_I) {
+    machine.indexReg = value;
+  } else if (index == REG_PC) {
+    machine.mem.setPC(value);
+  } else if (index == REG_DT) {
+    machine.timerDelay.setValue(value);
+  } else if (index == REG_ST) {
+    machine.timerSound.setValue(value);
+  }
+  // The stack depth is read-only.
+  return true;
+}
+
+std::string GdbStub::readRegisters(const Machine &machine) const {
+  std::string out;
+  for (size_t i = 0; i < REG_COUNT; ++i) {
+    out += readRegister(i, machine);
+  }
+  return out;
+}
+
+void GdbStub::writeRegisters(const std::string &hex, Machine &machine) {
+  size_t offset = 0;
+  for (size_t i = 0; i < REG_COUNT; ++i) {
+    const size_t width = 2 * registerSize(i);
+    if (offset + width > hex.size()) {
+      return;
+    }
+    writeRegister(i, hex.substr(offset, width), machine);
+    offset += width;
+  }
+}
+
+std::string GdbStub::readMemory(const std::string &args,
+                                const Machine &machine) {
+  size_t address = 0, length = 0, consumed = 0;
+  if (!parseRange(args, address, length, consumed) ||
+      address + length > Debugger::addressSpace) {
+    return "E01";
+  }
+  std::string out;
+  for (size_t i = 0; i < length; ++i) {
+    out += toHex(machine.mem.getByte(address + i), 1);
+  }
+  return out;
+}
+
+std::string GdbStub::writeMemory(const std::string &args, Machine &machine) {
+  size_t address = 0, length = 0, consumed = 0;
+  if (!parseRange(args, address, length, consumed) ||
+      consumed >= args.size() || args[consumed] != ':' ||
+      address + length > Debugger::addressSpace) {
+    return "E01";
+  }
+  const std::string data = args.substr(consumed + 1);
+  for (size_t i = 0; i < length; ++i) {
+    uint32_t byte = 0;
+    if (!fromHex(data, 2 * i, 1, byte)) {
+      return "E01";
+    }
+    machine.mem.setByte(address + i, static_cast<uint8_t>(byte));
+  }
+  return "OK";
+}
+
+std::string GdbStub::setPoint(const std::string &args, bool enabled) {
+  // type,addr,kind
+  const size_t comma = args.find(',');
+  if (comma == std::string::npos) {
+    return "E01";
+  }
+  const int type = std::atoi(args.substr(0, comma).c_str());
+  size_t address = 0, length = 0, consumed = 0;
+  if (!parseRange(args.substr(comma + 1), address, length, consumed) ||
+      address >= Debugger::addressSpace) {
+    return "E01";
+  }
+
+  switch (type) {
+    case 0:  // software breakpoint
+    case 1:  // hardware breakpoint
+      debugger.setBreakpoint(address, enabled);
+      return "OK";
+    case 2:  // write watchpoint
+      debugger.setWatch(address, length, false, true, enabled);
+      return "OK";
+    case 3:  // read watchpoint
+      debugger.setWatch(address, length, true, false, enabled);
+      return "OK";
+    case 4:  // access watchpoint
+      debugger.setWatch(address, length, true, true, enabled);
+      return "OK";
+    default:
+      return "";
+  }
+}
+
+void GdbStub::sendPacket(const std::string &payload) {
+  uint8_t sum = 0;
+  for (char c : payload) {
+    sum += static_cast<uint8_t>(c);
+  }
+  char trailer[4];
+  std::snprintf(trailer, sizeof(trailer), "#%02x", sum);
+  const std::string packet = "$" + payload + trailer;
+
+  size_t offset = 0;
+  while (clientFd >= 0 && offset < packet.size()) {
+    const ssize_t n = send(clientFd, packet.data() + offset,
+                           packet.size() - offset, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        pollfd pfd = {clientFd, POLLOUT, 0};
+        ::poll(&pfd, 1, 100);
+        continue;
+      }
+      closeClient();
+      return;
+    }
+    offset += n;
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef GDBSTUB_HPP
+#define GDBSTUB_HPP
+
+#include <string>
+
+#include "../cpu/machine.hpp"
+#include "debugger.hpp"
+
+// GDB remote serial protocol server for one client on a local TCP port or
+// Unix socket. The register file is exposed as v0-vf, i, pc, sp, dt and st
+// (see the target description served through qXfer). All socket I/O is
+// non-blocking and driven by poll() from the emulator loop.
+class GdbStub {
+public:
+  explicit GdbStub(Debugger &debugger);
+  ~GdbStub();
+  GdbStub(const GdbStub &) = delete;
+  GdbStub &operator=(const GdbStub &) = delete;
+
+  // Listens on 127.0.0.1:port.
+  bool listenTcp(int port);
+  bool listenUnix(const std::string &path);
+
+  // Accepts a client and answers its pending packets, reporting stops of
+  // the debugger. While the machine is halted it keeps serving for a few
+  // milliseconds so interactive sessions stay responsive.
+  void poll(Machine &machine);
+
+  // The client asked to kill the program.
+  bool wantsQuit() const;
+
+private:
+  void acceptClient();
+  bool readInput(int timeoutMs);
+  void processInput(Machine &machine);
+  void handlePacket(const std::string &packet, Machine &machine);
+  std::string readRegisters(const Machine &machine) const;
+  void writeRegisters(const std::string &hex, Machine &machine);
+  std::string readRegister(size_t index, const Machine &machine) const;
+  bool writeRegister(size_t index, const std::string &hex, Machine &machine);
+  std::string readMemory(const std::string &args, const Machine &machine);
+  std::string writeMemory(const std::string &args, Machine &machine);
+  std::string setPoint(const std::string &args, bool enabled);
+  std::string stopReply(const Machine &machine) const;
+  void sendPacket(const std::string &payload);
+  void closeClient();
+
+  Debugger &debugger;
+  int listenFd = -1;
+  int clientFd = -1;
+  std::string unixPath;
+  std::string input;
+  bool awaitingStop = false;
+  bool quit = false;
+};
+
+#endif  // GDBSTUB_HPP
@@ -2,117 +2,631 @@
 
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <stack>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "capture/capture.hpp"
 #include "components/components.hpp"
 #include "cpu/cpu.hpp"
+#include "cpu/fusion.hpp"
+#include "cpu/shadow.hpp"
+#include "cpu/timing.hpp"
+#include "debugger/debugger.hpp"
+#include "debugger/gdbstub.hpp"
+#include "latency/latency.hpp"
+#include "options/options.hpp"
+#include "profiler/profiler.hpp"
+#include "render/pixels.hpp"
+#include "render/hud.hpp"
+#include "render/terminal.hpp"
+#include "render/triplebuffer.hpp"
 
 const int CHIP8_WIDTH = 64;
 const int CHIP8_HEIGHT = 32;
 const int WINDOW_SCALE = 10;
 const int WINDOW_WIDTH = CHIP8_WIDTH * WINDOW_SCALE;
 const int WINDOW_HEIGHT = CHIP8_HEIGHT * WINDOW_SCALE;
+const int FRAMES_PER_SECOND = 60;
+// With --vsync, input is polled this long before the expected vblank, on top
+// of the time the last batch took.
+const std::chrono::microseconds LATE_POLL_MARGIN(2000);
+
+static const std::unordered_map<SDL_Keycode, Key> keyMapping = {
+    {SDLK_1, Key::One},   {SDLK_2, Key::Two},  {SDLK_3, Key::Three},
+    {SDLK_4, Key::C},     {SDLK_q, Key::Four}, {SDLK_w, Key::Five},
+    {SDLK_e, Key::Six},   {SDLK_r, Key::D},    {SDLK_a, Key::Seven},
+    {SDLK_s, Key::Eight}, {SDLK_d, Key::Nine}, {SDLK_f, Key::E},
+    {SDLK_z, Key::A},     {SDLK_x, Key::Zero}, {SDLK_c, Key::B},
+    {SDLK_v, Key::F}};
+
+void playBeep() {
+  const int SAMPLE_RATE = 44100;
+  const int FREQUENCY = 1000;
+  const int DURATION = 250;
+  const int NUM_SAMPLES = SAMPLE_RATE * DURATION / 1000;
+
+  SDL_AudioSpec spec;
+  SDL_zero(spec);
+  spec.freq = SAMPLE_RATE;
+  spec.format = AUDIO_S16SYS;
+  spec.channels = 1;
+  spec.samples = 2048;
+  spec.callback = nullptr;
+
+  if (SDL_OpenAudio(&spec, nullptr) < 0) {
+    std::cerr << "SDL_OpenAudio failed: " << SDL_GetError() << std::endl;
+    return;
+  }
+
+  Sint16 *buffer = new Sint16[NUM_SAMPLES];
+  for (int i = 0; i < NUM_SAMPLES; ++i) {
+    double time = i / (double)SAMPLE_RATE;
+    buffer[i] = (Sint16)(32767 * sin(2 * M_PI * FREQUENCY * time));
+  }
+
+  SDL_QueueAudio(1, buffer, NUM_SAMPLES * sizeof(Sint16));
+  SDL_PauseAudio(0);
+
+  SDL_Delay(DURATION);
+
+  SDL_CloseAudio();
+  delete[] buffer;
+}
+
+// With a HUD, the frame is expanded into its buffer and composed into the
+// larger texture together with the overlay. The present call blocks on vsync,
+// so the HUD counts it as sleep rather than render time.
+void renderFrame(SDL_Renderer *renderer, SDL_Texture *texture,
+                 PixelExpander &expander,
+                 const components::Display::Frame &frame, Hud *hud) {
+  const auto start = std::chrono::steady_clock::now();
+  void *pixels = nullptr;
+  int pitch = 0;
+  if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+    if (hud) {
+      expander.expand(frame, hud->pixels(),
+                      components::Display::cols * sizeof(uint32_t));
+      hud->compose(static_cast<uint32_t *>(pixels), pitch);
+    } else {
+      expander.expand(frame, static_cast<uint32_t *>(pixels), pitch);
+    }
+    SDL_UnlockTexture(texture);
+  }
+
+  SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+  const auto presentStart = std::chrono::steady_clock::now();
+  SDL_RenderPresent(renderer);
+  if (hud) {
+    const auto end = std::chrono::steady_clock::now();
+    hud->rendered(presentStart - start);
+    hud->slept(end - presentStart);
+    hud->presented(end);
+  }
+}
 
 int main(int argc, char **argv) {
-  std::cout << "I'm EMU!" << std::endl;
+  Options opts;
+  if (!parseOptions(argc, argv, opts)) {
+    return 1;
+  }
 
-  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-    std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError()
+  std::unique_ptr<FrameCapture> capture;
+  if (!opts.capture.empty()) {
+    CaptureFormat format;
+    std::string target;
+    if (!parseCaptureSpec(opts.capture, format, target)) {
+      std::cerr << "Invalid capture spec: " << opts.capture << std::endl;
+      return 1;
+    }
+    capture = std::make_unique<FrameCapture>(format, target);
+  }
+
+  // Keep stdout clean when it carries the raw video stream.
+  const bool stdoutCapture = opts.capture == "raw:-";
+  if ((opts.vsync || opts.threaded || opts.hud) && opts.headless) {
+    std::cerr << (opts.vsync      ? "--vsync"
+                  : opts.threaded ? "--threaded"
+                                  : "--hud")
+              << " needs a window" << std::endl;
+    return 1;
+  }
+  if (opts.threaded && (opts.latency || opts.hud)) {
+    std::cerr << (opts.latency ? "--latency" : "--hud")
+              << " is not supported with --threaded" << std::endl;
+    return 1;
+  }
+  if (opts.shadow && !opts.gdb.empty()) {
+    std::cerr << "--shadow cannot follow memory changes made from GDB"
               << std::endl;
     return 1;
   }
+  if (stdoutCapture && opts.ansi) {
+    std::cerr << "--ansi and raw capture to stdout both need stdout"
+              << std::endl;
+    return 1;
+  }
+  (stdoutCapture ? std::cerr : std::cout) << "I'm EMU!" << std::endl;
 
-  SDL_Window *window = SDL_CreateWindow(
-      "CHIP-8 Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-      WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
+  std::unique_ptr<TerminalRenderer> terminal;
+  if (opts.ansi) {
+    terminal = std::make_unique<TerminalRenderer>();
+  }
 
-  if (!window) {
-    std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError()
-              << std::endl;
-    SDL_Quit();
+  Palette palette;
+  if (!parsePalette(opts.palette, palette)) {
+    std::cerr << "Invalid palette: " << opts.palette << std::endl;
     return 1;
   }
+  PixelExpander expander;
+  expander.setPalette(palette);
+  expander.setPersistence(opts.persistence);
 
-  SDL_Renderer *renderer =
-      SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-  if (!renderer) {
-    std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError()
-              << std::endl;
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+  SDL_Window *window = nullptr;
+  SDL_Renderer *renderer = nullptr;
+  SDL_Texture *texture = nullptr;
+
+  if (!opts.headless) {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+      std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError()
+                << std::endl;
+      return 1;
+    }
+
+    window = SDL_CreateWindow("CHIP-8 Emulator", SDL_WINDOWPOS_CENTERED,
+                              SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH,
+                              WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
+
+    if (!window) {
+      std::cerr << "Window could not be created! SDL_Error: "
+                << SDL_GetError() << std::endl;
+      SDL_Quit();
+      return 1;
+    }
+
+    const Uint32 rendererFlags =
+        SDL_RENDERER_ACCELERATED | (opts.vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+    renderer = SDL_CreateRenderer(window, -1, rendererFlags);
+    if (!renderer) {
+      std::cerr << "Renderer could not be created! SDL_Error: "
+                << SDL_GetError() << std::endl;
+      SDL_DestroyWindow(window);
+      SDL_Quit();
+      return 1;
+    }
+
+    texture = SDL_CreateTexture(
+        renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        opts.hud ? Hud::WIDTH : CHIP8_WIDTH,
+        opts.hud ? Hud::HEIGHT : CHIP8_HEIGHT);
+    if (!texture) {
+      std::cerr << "Texture could not be created! SDL_Error: "
+                << SDL_GetError() << std::endl;
+      SDL_DestroyRenderer(renderer);
+      SDL_DestroyWindow(window);
+      SDL_Quit();
+      return 1;
+    }
+  }
+
+  if (capture && !capture->start()) {
     return 1;
   }
 
-  components::Memory mem;
-  components::Display disp;
-  components::Registers variableRegs;
-  uint16_t indexReg;
-  std::stack<uint16_t> stack;
-  Timer timerDelay(false), timerSound(true);
-  timerDelay.start(1000 / 60, "timerDelay");
-  timerSound.start(1000 / 60, "timerSound");
+  Machine machine;
+  IdleDetector idle;
+  VipTiming vipTiming;
+  Fuser fuser;
+
+  // The debugger only exists when requested, and frames then run through
+  // runFrameDebug(); otherwise the plain runFrame() path is used.
+  std::unique_ptr<Debugger> debugger;
+  std::unique_ptr<GdbStub> gdb;
+  if (!opts.gdb.empty()) {
+    debugger = std::make_unique<Debugger>();
+    gdb = std::make_unique<GdbStub>(*debugger);
+    const bool listening =
+        opts.gdb.rfind("unix:", 0) == 0
+            ? gdb->listenUnix(opts.gdb.substr(5))
+            : gdb->listenTcp(std::atoi(opts.gdb.c_str()));
+    if (!listening) {
+      std::cerr << "Cannot start GDB stub on " << opts.gdb << std::endl;
+      return 1;
+    }
+  }
+
+  const std::chrono::nanoseconds frameDuration =
+      std::chrono::nanoseconds(std::chrono::seconds(1)) / FRAMES_PER_SECOND;
+
+  // --vsync: the display refresh drives presentation, and emulated time owed
+  // to it decides how many frames each refresh runs.
+  std::chrono::nanoseconds refreshPeriod = frameDuration;
+  if (opts.vsync) {
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) ==
+            0 &&
+        mode.refresh_rate > 0) {
+      refreshPeriod =
+          std::chrono::nanoseconds(std::chrono::seconds(1)) / mode.refresh_rate;
+    }
+  }
+  std::chrono::nanoseconds owed = frameDuration;
+  std::chrono::nanoseconds lastWork(0);
 
-  int instructionsPerSecond = 700;
-  std::chrono::milliseconds timeOrderInMs(1000);
-  std::chrono::milliseconds timePerInstruction(timeOrderInMs.count() /
-                                               instructionsPerSecond);
+  std::unique_ptr<Profiler> profiler;
+  if (!opts.profile.empty()) {
+    profiler = std::make_unique<Profiler>();
+  }
+
+  std::unique_ptr<LatencyTracker> latency;
+  if (opts.latency) {
+    latency = std::make_unique<LatencyTracker>();
+  }
+
+  std::unique_ptr<ShadowValidator> shadow;
+  if (opts.shadow) {
+    shadow = std::make_unique<ShadowValidator>(opts.shadowInterval);
+  }
+
+  // Quirks are fixed in this interpreter; --vip adds the display wait.
+  std::unique_ptr<Hud> hud;
+  if (opts.hud) {
+    std::string engine = "INTERPRETER";
+    if (gdb) {
+      engine = "DEBUGGER";
+    } else if (profiler) {
+      engine = "PROFILER";
+    } else if (opts.vip) {
+      engine = "VIP TIMING";
+    } else if (opts.fuse) {
+      engine = "FUSED";
+    }
+    std::string quirks =
+        "QUIRKS SHIFT-VX I-KEPT JUMP-V0 SPRITE-WRAP FX1E-VF-KEPT";
+    if (opts.vip) {
+      quirks += " VBLANK-WAIT";
+    }
+    hud = std::make_unique<Hud>(engine, quirks, frameDuration,
+                                opts.vip ? 0 : opts.instructionsPerSecond);
+  }
 
-  mem.loadBinary("../binaries/");
+  machine.mem.loadBinary(opts.romDirectory);
 
-  bool running = true;
+  std::atomic<bool> running{true};
+  std::atomic<bool> turbo{opts.turbo};
+  bool lastTurbo = turbo;
+  bool beepPlayed = false;
+  uint64_t frame = 0;
+  int framesSincePresent = 0;
   SDL_Event event;
+  auto nextFrame = std::chrono::steady_clock::now();
+  auto lastPresent = nextFrame - frameDuration;
+  auto lastVsync = nextFrame;
+
+  // With --threaded, the main thread polls events and presents while the
+  // emulation loop below runs on its own thread. Frames go out through a
+  // triple buffer and keys come back as atomic bitmasks, so a present that
+  // blocks on vsync or the compositor never stalls emulation.
+  std::unique_ptr<TripleBuffer<components::Display::Frame>> frames;
+  if (opts.threaded) {
+    frames = std::make_unique<TripleBuffer<components::Display::Frame>>();
+  }
+  // Low 16 bits: keys held. High 16 bits: keys released since the emulation
+  // thread last looked, so a tap between two frames still reaches FX0A.
+  std::atomic<uint32_t> keyState{0};
+  uint16_t appliedKeys = 0;
 
-  while (running) {
-    while (SDL_PollEvent(&event)) {
+  auto pollEvents = [&] {
+    while (!opts.headless && SDL_PollEvent(&event)) {
       if (event.type == SDL_QUIT) {
         running = false;
+      } else if (event.type == SDL_KEYDOWN && event.key.repeat == 0 &&
+                 event.key.keysym.sym == SDLK_TAB) {
+        turbo = !turbo;
+      } else if (event.type == SDL_KEYDOWN && event.key.repeat == 0 &&
+                 event.key.keysym.sym == SDLK_F1 && hud) {
+        hud->toggle();
+      } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+        auto it = keyMapping.find(event.key.keysym.sym);
+        if (it != keyMapping.end() && event.key.repeat == 0) {
+          const uint8_t key = translateKeyToChar(it->second);
+          const bool pressed = event.type == SDL_KEYDOWN;
+          if (frames) {
+            const uint32_t bit = 1u << key;
+            uint32_t state = keyState.load(std::memory_order_relaxed);
+            while (!keyState.compare_exchange_weak(
+                state, pressed ? state | bit : (state & ~bit) | (bit << 16),
+                std::memory_order_relaxed)) {
+            }
+            continue;
+          }
+          machine.keypad.setKey(key, pressed);
+          if (latency) {
+            latency->keyEvent(key, std::chrono::steady_clock::now());
+          }
+        }
       }
     }
+  };
+
+  auto emulate = [&] {
+    while (running) {
+      if (frames) {
+        // Pick up the keys the main thread saw since the last frame.
+        const uint32_t state =
+            keyState.fetch_and(0xFFFF, std::memory_order_relaxed);
+        const uint16_t keys = state & 0xFFFF;
+        const uint16_t released = state >> 16;
+        for (uint8_t key = 0; key < 16; ++key) {
+          bool held = (appliedKeys >> key) & 1;
+          if ((released >> key) & 1) {
+            // Replay both edges of a tap this thread never saw held.
+            if (!held) {
+              machine.keypad.setKey(key, true);
+            }
+            machine.keypad.setKey(key, false);
+            held = false;
+          }
+          if (held != bool((keys >> key) & 1)) {
+            machine.keypad.setKey(key, !held);
+          }
+        }
+        appliedKeys = keys;
+      } else {
+        pollEvents();
+      }
+      if (turbo != lastTurbo) {
+        lastTurbo = turbo;
+        nextFrame = std::chrono::steady_clock::now();
+        owed = frameDuration;
+      }
+      const auto workStart = std::chrono::steady_clock::now();
+
+      // Spread instructionsPerSecond evenly over the frames of each second.
+      const uint64_t ips = opts.instructionsPerSecond;
+      const size_t budget = (ips * (frame + 1)) / FRAMES_PER_SECOND -
+                            (ips * frame) / FRAMES_PER_SECOND;
+      size_t executed = 0;
+      if (shadow) {
+        shadow->beginFrame(machine);
+      }
+      if (gdb) {
+        gdb->poll(machine);
+        if (gdb->wantsQuit()) {
+          running = false;
+        }
+        executed = runFrameDebug(machine, budget, *debugger);
+      } else if (profiler) {
+        executed = runFrameProfiled(machine, budget, *profiler);
+      } else if (opts.vip) {
+        executed = vipTiming.runFrame(machine);
+      } else if (opts.fuse) {
+        executed = runFrameFused(machine, budget, idle, fuser);
+      } else {
+        executed = runFrame(machine, budget, idle);
+      }
+      if (shadow && !shadow->endFrame(machine, executed)) {
+        std::cerr << shadow->getReport();
+        running = false;
+      }
+      if (hud) {
+        hud->emulated(std::chrono::steady_clock::now() - workStart, executed);
+      }
+      // Under a debugger a fault halts the machine for inspection instead.
+      if (!gdb && machine.fault != Fault::None) {
+        running = false;
+      }
+
+      // A machine halted in the debugger does not advance emulated time.
+      if (executed > 0 || !debugger || !debugger->isHalted()) {
+        frame++;
 
-    auto execStart = std::chrono::steady_clock::now();
+        // Timers follow emulated frames, so they speed up together with the
+        // CPU in turbo mode.
+        machine.keypad.clearReleased();
+        machine.timerDelay.tick();
+        machine.timerSound.tick();
 
-    auto instruction = fetch(mem);
-    decodeAndExecute(instruction, disp, mem, stack, variableRegs, indexReg,
-                     timerDelay, timerSound);
+        if (latency) {
+          latency->frameDone(machine.keypad.takeObserved(),
+                             machine.disp.getHash(),
+                             std::chrono::steady_clock::now());
+        }
+      }
 
-    auto execEnd = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-        execEnd - execStart);
+      if (machine.timerSound.getValue() == 0) {
+        beepPlayed = false;
+      } else if (!beepPlayed && !turbo && !opts.headless) {
+        std::thread(playBeep).detach();
+        beepPlayed = true;
+      }
 
-    if (elapsed < timePerInstruction) {
-      auto remainingTime = timePerInstruction - elapsed;
-      std::this_thread::sleep_for(remainingTime);
-    }
+      auto now = std::chrono::steady_clock::now();
+      framesSincePresent++;
+
+      if (opts.maxFrames > 0 && frame >= uint64_t(opts.maxFrames)) {
+        running = false;
+      }
+
+      if (opts.vsync && !turbo && !frames) {
+        // Present once every frame due before the next refresh has run. The
+        // present blocks until vblank; refreshes faster than the frame rate
+        // show the same frame again.
+        owed -= frameDuration;
+        if (owed < frameDuration || !running) {
+          lastWork = std::chrono::steady_clock::now() - workStart;
+          bool first = true;
+          do {
+            renderFrame(renderer, texture, expander, machine.disp.getFrame(),
+                        hud.get());
+            if (first && latency) {
+              latency->presented(std::chrono::steady_clock::now());
+            }
+            first = false;
+            owed += refreshPeriod;
+          } while (owed < frameDuration);
+          lastVsync = std::chrono::steady_clock::now();
+          if (hud) {
+            hud->dropped(framesSincePresent - 1);
+          }
+          framesSincePresent = 0;
+          if (capture) {
+            capture->submit(machine.disp, frame);
+          }
+        }
+        // Before the last frame of a batch, sleep until just ahead of the
+        // next vblank so that its input is polled as late as possible.
+        if (owed < 2 * frameDuration) {
+          const auto sleepStart = std::chrono::steady_clock::now();
+          std::this_thread::sleep_until(lastVsync + refreshPeriod -
+                                        LATE_POLL_MARGIN - lastWork);
+          if (hud) {
+            hud->slept(std::chrono::steady_clock::now() - sleepStart);
+          }
+        }
+        nextFrame = std::chrono::steady_clock::now();
+        continue;
+      }
 
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black background
-    SDL_RenderClear(renderer);
+      bool present = true;
+      if (turbo && running) {
+        present = opts.frameSkip > 0 ? framesSincePresent >= opts.frameSkip
+                                     : now - lastPresent >= frameDuration;
+      }
+      if (present) {
+        if (frames) {
+          frames->back() = machine.disp.getFrame();
+          frames->publish();
+        } else if (renderer) {
+          renderFrame(renderer, texture, expander, machine.disp.getFrame(),
+                      hud.get());
+        }
+        if (terminal) {
+          terminal->present(machine.disp);
+        }
+        if (capture) {
+          capture->submit(machine.disp, frame);
+        }
+        if (latency) {
+          latency->presented(std::chrono::steady_clock::now());
+        }
+        if (hud) {
+          hud->dropped(framesSincePresent - 1);
+        }
+        lastPresent = now;
+        framesSincePresent = 0;
+      }
 
-    for (int x = 0; x < 2 * CHIP8_HEIGHT; ++x) {
-      for (int y = 0; y < CHIP8_WIDTH; ++y) {
-        if (disp.getPixel(y, x)) {
-          SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        } else {
-          SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+      if (turbo && opts.turboSpeed == 0) {
+        nextFrame = now;
+        continue;
+      }
+
+      // Idle frames finish early; the host sleeps for the rest of the frame
+      // instead of spinning through the guest's wait loop.
+      const int speed = turbo ? opts.turboSpeed : 1;
+      nextFrame += std::chrono::duration_cast<
+          std::chrono::steady_clock::duration>(frameDuration / speed);
+      now = std::chrono::steady_clock::now();
+      if (nextFrame > now) {
+        std::this_thread::sleep_until(nextFrame);
+        if (hud) {
+          hud->slept(std::chrono::steady_clock::now() - now);
+        }
+      } else {
+        nextFrame = now;
+        if (hud) {
+          hud->late();
         }
-        SDL_Rect rect = {x * WINDOW_SCALE, y * WINDOW_SCALE, WINDOW_SCALE,
-                         WINDOW_SCALE};
-        SDL_RenderFillRect(renderer, &rect);
       }
     }
+  };
+
+  if (!frames) {
+    emulate();
+  } else {
+    std::thread emulation(emulate);
+    while (running) {
+      pollEvents();
+      if (frames->update()) {
+        renderFrame(renderer, texture, expander, frames->front(), nullptr);
+      } else {
+        // Nothing new yet; with vsync the present above already paced us.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    emulation.join();
+    if (frames->update()) {
+      renderFrame(renderer, texture, expander, frames->front(), nullptr);
+    }
+  }
+
+  if (capture) {
+    capture->stop();
+    std::cerr << "Capture: " << capture->getWritten() << " written, "
+              << capture->getDuplicates() << " duplicates, "
+              << capture->getDropped() << " dropped, " << capture->getErrors()
+              << " errors" << std::endl;
+  }
+
+  if (latency) {
+    latency->report(std::cerr);
+  }
+
+  if (profiler) {
+    std::ofstream cycles(opts.profile + ".cycles.folded");
+    profiler->writeFolded(cycles, true);
+    std::ofstream instructions(opts.profile + ".instructions.folded");
+    profiler->writeFolded(instructions, false);
+    std::ofstream heat(opts.profile + ".heat.csv");
+    profiler->writeHeatMap(heat);
+    if (!cycles || !instructions || !heat) {
+      std::cerr << "Cannot write profile " << opts.profile << std::endl;
+    } else {
+      std::cerr << "Profile: " << profiler->getInstructions()
+                << " instructions written to " << opts.profile
+                << ".{cycles.folded,instructions.folded,heat.csv}"
+                << std::endl;
+    }
+  }
 
-    SDL_RenderPresent(renderer);
+  if (opts.fuse) {
+    fuser.report(std::cerr);
   }
 
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyWindow(window);
-  SDL_Quit();
+  if (shadow && !shadow->hasDiverged()) {
+    std::cerr << "Shadow: " << shadow->getFramesChecked() << " frames, "
+              << shadow->getInstructionsChecked()
+              << " instructions matched the reference" << std::endl;
+  }
 
-  return 0;
+  if (opts.vip && vipTiming.getFrames() > 0) {
+    const uint64_t frames = vipTiming.getFrames();
+    std::cerr << "VIP timing: " << vipTiming.getInstructions()
+              << " instructions, " << vipTiming.getCycles() << " cycles in "
+              << frames << " frames ("
+              << vipTiming.getInstructions() * FRAMES_PER_SECOND / frames
+              << " instructions per second)" << std::endl;
+  }
+
+  if (!opts.headless) {
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+  }
+
+  if (machine.fault != Fault::None) {
+    std::cerr << "Fault: " << describeFault(machine) << std::endl;
+    return 2;
+  }
+  return shadow && shadow->hasDiverged() ? 3 : 0;
 }
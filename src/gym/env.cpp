@@ -0,0 +1,250 @@
+#include "env.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const int FRAMES_PER_SECOND = 60;
+
+uint16_t probeValue(const Machine &machine, uint16_t address, bool wide) {
+  const uint16_t high = machine.mem.getByte(address);
+  return wide ? (high << 8) | machine.mem.getByte(address + 1) : high;
+}
+
+// splitmix64, to derive independent per-environment seeds.
+uint64_t mixSeed(uint64_t value) {
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+}  // namespace
+
+BatchEnv::BatchEnv(EnvConfig config, size_t batchSize, size_t threads)
+    : config(std::move(config)), envs(batchSize) {
+  if (!pristine.mem.loadIntoMemory(this->config.rom)) {
+    throw std::invalid_argument("ROM does not fit in memory");
+  }
+  for (const RewardProbe &probe : this->config.rewards) {
+    if (size_t(probe.address) + (probe.wide ? 1 : 0) >= MEMORY_SIZE) {
+      throw std::invalid_argument("reward probe past the end of memory");
+    }
+  }
+  for (const DoneProbe &probe : this->config.dones) {
+    if (probe.address >= MEMORY_SIZE) {
+      throw std::invalid_argument("done probe past the end of memory");
+    }
+  }
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  slices = std::min(threads, std::max<size_t>(batchSize, 1));
+  workers.reserve(slices - 1);
+  // The calling thread takes the first slice itself.
+  for (size_t worker = 1; worker < slices; ++worker) {
+    workers.emplace_back(&BatchEnv::workerLoop, this, worker);
+  }
+}
+
+BatchEnv::~BatchEnv() {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    stopping = true;
+  }
+  startJob.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+size_t BatchEnv::size() const { return envs.size(); }
+
+void BatchEnv::reset(uint64_t newSeed, uint8_t *observations) {
+  seed = newSeed;
+  jobObservations = observations;
+  runParallel(Job::Reset);
+}
+
+void BatchEnv::step(const uint16_t *actions, uint8_t *observations,
+                    float *rewards, uint8_t *dones) {
+  jobActions = actions;
+  jobObservations = observations;
+  jobRewards = rewards;
+  jobDones = dones;
+  runParallel(Job::Step);
+}
+
+void BatchEnv::resetEnv(size_t index) {
+  Env &env = envs[index];
+  // Copy-assignment reuses the buffers the machine already owns.
+  env.machine = pristine;
+  env.machine.rng.seed(mixSeed(seed ^ mixSeed(index) ^ env.episode));
+  env.idle = IdleDetector();
+  env.frame = 0;
+  env.steps = 0;
+  env.episode++;
+}
+
+void BatchEnv::resetRange(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    envs[i].episode = 0;
+    resetEnv(i);
+    observe(envs[i], jobObservations + i * OBSERVATION_SIZE);
+  }
+}
+
+void BatchEnv::stepRange(size_t begin, size_t end) {
+  const uint16_t *actions = jobActions;
+  float *rewards = jobRewards;
+  uint8_t *dones = jobDones;
+  for (size_t i = begin; i < end; ++i) {
+    Env &env = envs[i];
+    Machine &machine = env.machine;
+
+    for (uint8_t key = 0; key < 16; ++key) {
+      machine.keypad.setKey(key, (actions[i] >> key) & 1);
+    }
+
+    const float before = probeRewards(machine);
+    const uint64_t ips = config.instructionsPerSecond;
+    for (int f = 0;
+         f < config.framesPerStep && machine.fault == Fault::None; ++f) {
+      const size_t budget = (ips * (env.frame + 1)) / FRAMES_PER_SECOND -
+                            (ips * env.frame) / FRAMES_PER_SECOND;
+      runFrame(machine, budget, env.idle);
+      env.frame++;
+      machine.keypad.clearReleased();
+      machine.timerDelay.tick();
+      machine.timerSound.tick();
+    }
+    env.steps++;
+
+    rewards[i] = probeRewards(machine) - before;
+    const bool done = machine.fault != Fault::None || probeDone(machine) ||
+                      (config.maxSteps > 0 && env.steps >= config.maxSteps);
+    dones[i] = done;
+    if (done) {
+      resetEnv(i);
+    }
+    observe(env, jobObservations + i * OBSERVATION_SIZE);
+  }
+}
+
+void BatchEnv::runSlice(size_t begin, size_t end) {
+  switch (job) {
+    case Job::Reset:
+      resetRange(begin, end);
+      break;
+    case Job::Step:
+      stepRange(begin, end);
+      break;
+  }
+}
+
+void BatchEnv::observe(const Env &env, uint8_t *observation) const {
+  for (uint64_t row : env.machine.disp.getFrame()) {
+    for (int byte = 0; byte < 8; ++byte) {
+      *observation++ = static_cast<uint8_t>(row >> (56 - 8 * byte));
+    }
+  }
+}
+
+float BatchEnv::probeRewards(const Machine &machine) const {
+  float total = 0.0f;
+  for (const RewardProbe &probe : config.rewards) {
+    total += probe.scale * probeValue(machine, probe.address, probe.wide);
+  }
+  return total;
+}
+
+bool BatchEnv::probeDone(const Machine &machine) const {
+  for (const DoneProbe &probe : config.dones) {
+    const bool equal =
+        (machine.mem.getByte(probe.address) & probe.mask) == probe.value;
+    if (equal == probe.whenEqual) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BatchEnv::runParallel(Job next) {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    job = next;
+    pending = slices - 1;
+    generation++;
+  }
+  startJob.notify_all();
+
+  runSlice(0, envs.size() / slices);
+
+  std::unique_lock<std::mutex> lock(poolMutex);
+  jobDone.wait(lock, [this] { return pending == 0; });
+}
+
+void BatchEnv::workerLoop(size_t worker) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(poolMutex);
+      startJob.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+
+    const size_t begin = envs.size() * worker / slices;
+    const size_t end = envs.size() * (worker + 1) / slices;
+    runSlice(begin, end);
+
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      pending--;
+    }
+    jobDone.notify_one();
+  }
+}
+
+SharedObservations::SharedObservations(const std::string &name,
+                                       size_t batchSize)
+    : name(name), length(batchSize * OBSERVATION_SIZE) {
+  // O_EXCL so a name another process is using is never taken over.
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return;
+  }
+  created = true;
+  if (ftruncate(fd, length) == 0) {
+    void *mapped =
+        mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped != MAP_FAILED) {
+      mapping = static_cast<uint8_t *>(mapped);
+    }
+  }
+  close(fd);
+}
+
+SharedObservations::~SharedObservations() {
+  if (mapping) {
+    munmap(mapping, length);
+  }
+  if (created) {
+    shm_unlink(name.c_str());
+  }
+}
+
+bool SharedObservations::isValid() const { return mapping != nullptr; }
+
+uint8_t *SharedObservations::data() const { return mapping; }
+
+size_t SharedObservations::bytes() const { return length; }
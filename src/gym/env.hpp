@@ -0,0 +1,132 @@
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../cpu/cpu.hpp"
+
+// Reward term: scale * (value after the step - value before), where value is
+// the byte at address (or the big-endian word at address when wide).
+struct RewardProbe {
+  uint16_t address = 0;
+  float scale = 1.0f;
+  bool wide = false;
+};
+
+// Episode end: (byte at address & mask) == value, or != value when
+// whenEqual is false.
+struct DoneProbe {
+  uint16_t address = 0;
+  uint8_t value = 0;
+  uint8_t mask = 0xFF;
+  bool whenEqual = true;
+};
+
+struct EnvConfig {
+  std::vector<char> rom;
+  int instructionsPerSecond = 700;
+  // Frames emulated per step with the action held (action repeat).
+  int framesPerStep = 4;
+  // Episodes are cut after this many steps; 0 never truncates.
+  int maxSteps = 0;
+  std::vector<RewardProbe> rewards;
+  std::vector<DoneProbe> dones;
+};
+
+// Observation of one environment: the packed framebuffer, 32 rows of 8 bytes,
+// column 0 in the most significant bit of each row's first byte.
+const size_t OBSERVATION_SIZE = 256;
+
+// A batch of machines stepped in lockstep, in the style of a vectorized Gym
+// environment. Output arrays are provided by the caller and written in place,
+// so a step allocates nothing. Environments that finish are reset right away
+// and report the first observation of their next episode; a machine fault
+// ends the episode the same way. The batch is split
+// in contiguous slices over a pool of persistent worker threads.
+class BatchEnv {
+public:
+  // threads == 0 uses every hardware thread. Throws std::invalid_argument if
+  // the ROM does not fit or a probe reads past the end of memory.
+  BatchEnv(EnvConfig config, size_t batchSize, size_t threads = 0);
+  ~BatchEnv();
+  BatchEnv(const BatchEnv &) = delete;
+  BatchEnv &operator=(const BatchEnv &) = delete;
+
+  size_t size() const;
+
+  // observations: size() * OBSERVATION_SIZE bytes.
+  void reset(uint64_t seed, uint8_t *observations);
+  // actions: one keypad bitmask per environment (bit N = key N held).
+  void step(const uint16_t *actions, uint8_t *observations, float *rewards,
+            uint8_t *dones);
+
+private:
+  struct Env {
+    Machine machine;
+    IdleDetector idle;
+    uint64_t frame = 0;
+    int steps = 0;
+    uint32_t episode = 0;
+  };
+
+  // What the pool runs; the arguments are in the job* members.
+  enum class Job { Reset, Step };
+
+  void resetEnv(size_t index);
+  void resetRange(size_t begin, size_t end);
+  void stepRange(size_t begin, size_t end);
+  void runSlice(size_t begin, size_t end);
+  void observe(const Env &env, uint8_t *observation) const;
+  float probeRewards(const Machine &machine) const;
+  bool probeDone(const Machine &machine) const;
+  void runParallel(Job job);
+  void workerLoop(size_t worker);
+
+  EnvConfig config;
+  Machine pristine;
+  std::vector<Env> envs;
+  uint64_t seed = 0;
+
+  size_t slices = 1;
+  std::vector<std::thread> workers;
+  std::mutex poolMutex;
+  std::condition_variable startJob;
+  std::condition_variable jobDone;
+  Job job = Job::Reset;
+  const uint16_t *jobActions = nullptr;
+  uint8_t *jobObservations = nullptr;
+  float *jobRewards = nullptr;
+  uint8_t *jobDones = nullptr;
+  uint64_t generation = 0;
+  size_t pending = 0;
+  bool stopping = false;
+};
+
+// Observation buffer in POSIX shared memory, for consumers in another
+// process. The name must not exist yet; the object that created it unlinks
+// it on destruction.
+class SharedObservations {
+public:
+  SharedObservations(const std::string &name, size_t batchSize);
+  ~SharedObservations();
+  SharedObservations(const SharedObservations &) = delete;
+  SharedObservations &operator=(const SharedObservations &) = delete;
+
+  bool isValid() const;
+  uint8_t *data() const;
+  size_t bytes() const;
+
+private:
+  std::string name;
+  size_t length = 0;
+  bool created = false;
+  uint8_t *mapping = nullptr;
+};
+
+#endif  // ENV_HPP
@@ -1,21 +1,19 @@
 #include "../instructions/instructions.hpp"
 
-#include <SDL.h>
-#include <fcntl.h>
-#include <linux/input.h>
-#include <stdio.h>
-#include <unistd.h>
-
 #include <cstdint>
 #include <iostream>
-#include <random>
 #include <stack>
-#include <unordered_map>
 
 #include "../components/components.hpp"
 
 constexpr uint8_t FLAG = 15;
 
+// True if [start, start + length) lies inside memory. Checked up front so a
+// faulting instruction leaves the machine untouched.
+static bool inMemory(size_t start, size_t length) {
+  return start + length <= MEMORY_SIZE;
+}
+
 void clearScreen(Display &display) { display.setAllPixels(false); }
 
 void jumpTo(uint16_t instruction, Memory &mem) {
@@ -23,22 +21,25 @@ void jumpTo(uint16_t instruction, Memory &mem) {
   mem.setPC(newPC);
 }
 
-void callSubroutine(uint16_t instruction, Memory &mem,
-                    std::stack<uint16_t> &stack) {
+Fault callSubroutine(uint16_t instruction, Memory &mem,
+                     std::stack<uint16_t> &stack) {
+  if (stack.size() >= STACK_DEPTH) {
+    return Fault::StackOverflow;
+  }
   stack.push(mem.getPC());
   jumpTo(instruction, mem);
+  return Fault::None;
 }
 
-void retFromSubroutine(Memory &mem, std::stack<uint16_t> &stack) {
+Fault retFromSubroutine(Memory &mem, std::stack<uint16_t> &stack) {
   if (stack.empty()) {
-    std::cerr << "Error: Stack is empty, cannot return from subroutine"
-              << std::endl;
-    exit(1);
+    return Fault::StackUnderflow;
   }
 
   uint16_t ret = stack.top();
   stack.pop();
   mem.setPC(ret);
+  return Fault::None;
 }
 
 void setRegister(uint16_t instruction, components::Registers &variableRegs) {
@@ -60,9 +61,9 @@ void setIndexRegister(uint16_t instruction, uint16_t &indexReg) {
   indexReg = instruction & 0x0FFF;
 }
 
-void displaySprite(uint16_t instruction, components::Registers &variableRegs,
-                   components::Memory &mem, components::Display &display,
-                   uint16_t &indexReg) {
+Fault displaySprite(uint16_t instruction, components::Registers &variableRegs,
+                    components::Memory &mem, components::Display &display,
+                    uint16_t &indexReg) {
   const size_t SCREEN_HEIGHT = display.getRows();
   const size_t SCREEN_WIDTH = display.getCols();
   const uint8_t SPRITE_WIDTH = 8;
@@ -72,6 +73,10 @@ void displaySprite(uint16_t instruction, components::Registers &variableRegs,
   const uint8_t Y = (instruction & 0x00F0) >> 4;
   const uint8_t N = instruction & 0x000F;
 
+  if (!inMemory(indexReg, N)) {
+    return Fault::AddressOutOfRange;
+  }
+
   const uint8_t startRow = variableRegs.getReg(Y) % SCREEN_HEIGHT;
   const uint8_t startCol = variableRegs.getReg(X) % SCREEN_WIDTH;
 
@@ -99,10 +104,11 @@ void displaySprite(uint16_t instruction, components::Registers &variableRegs,
   if (pixelFlipped) {
     variableRegs.setReg(FLAG_REGISTER, 1);
   }
+  return Fault::None;
 }
 
-void conditional(uint16_t instruction, components::Registers &variableRegs,
-                 components::Memory &mem) {
+Fault conditional(uint16_t instruction, components::Registers &variableRegs,
+                  components::Memory &mem) {
   const uint8_t instCode = (instruction & 0xF000) >> 12;
   const uint8_t x = (instruction & 0x0F00) >> 8;
   const uint8_t nn = instruction & 0x00FF;
@@ -120,25 +126,32 @@ void conditional(uint16_t instruction, components::Registers &variableRegs,
     conditionMet = (regXVal != nn);
     break;
   case 5: {
+    if ((instruction & 0x000F) != 0) {
+      return Fault::IllegalOpcode;
+    }
     const uint8_t regYVal = variableRegs.getReg(y);
     conditionMet = (regXVal == regYVal);
     break;
   }
   case 9: {
+    if ((instruction & 0x000F) != 0) {
+      return Fault::IllegalOpcode;
+    }
     const uint8_t regYVal = variableRegs.getReg(y);
     conditionMet = (regXVal != regYVal);
     break;
   }
   default:
-    return;
+    return Fault::IllegalOpcode;
   }
 
   if (conditionMet) {
     mem.setPC(mem.getPC() + 2);
   }
+  return Fault::None;
 }
 
-void arithmetic(uint16_t instruction, components::Registers &variableRegs) {
+Fault arithmetic(uint16_t instruction, components::Registers &variableRegs) {
   const uint8_t x = (instruction & 0x0F00) >> 8;
   const uint8_t y = (instruction & 0x00F0) >> 4;
   const uint8_t subinst = (instruction & 0x000F);
@@ -193,25 +206,25 @@ void arithmetic(uint16_t instruction, components::Registers &variableRegs) {
     break;
   }
   default:
-    return;
+    return Fault::IllegalOpcode;
   }
+  return Fault::None;
 }
 
 void jumpOffset(uint16_t instruction, components::Registers &variableRegs,
                 components::Memory &mem) {
-  const uint16_t newPC = instruction & 0x0FFF + variableRegs.getReg(0);
+  // Addresses are 12 bits wide, so a target past 0xFFF wraps around.
+  const uint16_t newPC =
+      ((instruction & 0x0FFF) + variableRegs.getReg(0)) & 0x0FFF;
   mem.setPC(newPC);
 }
 
-void random(uint16_t instruction, components::Registers &variableRegs) {
+void random(uint16_t instruction, components::Registers &variableRegs,
+            components::Rng &rng) {
   const uint8_t x = (instruction & 0x0F00) >> 8;
   const uint8_t nn = instruction & 0x00FF;
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<uint8_t> distrib(0, nn);
-
-  uint8_t randomValue = distrib(gen);
+  uint8_t randomValue = rng.next() & nn;
   variableRegs.setReg(x, randomValue);
 }
 
@@ -229,112 +242,42 @@ void modTimer(uint16_t instruction, components::Registers &variableRegs,
 void addToIndex(uint16_t instruction, components::Registers &variableRegs,
                 uint16_t &indexReg) {
   const uint8_t x = (instruction & 0x0F00) >> 8;
-  const uint32_t sum = indexReg + variableRegs.getReg(x);
-  if (sum > UINT16_MAX) {
-    variableRegs.setReg(FLAG, 1);
-  }
+  // COSMAC VIP behaviour: VF is left alone. The Amiga interpreter's overflow
+  // flag is not emulated.
   indexReg = indexReg + variableRegs.getReg(x);
 }
 
-static const std::unordered_map<SDL_Keycode, Key> keyMapping = {
-    {SDLK_1, Key::One},   {SDLK_2, Key::Two},  {SDLK_3, Key::Three},
-    {SDLK_4, Key::C},     {SDLK_q, Key::Four}, {SDLK_w, Key::Five},
-    {SDLK_e, Key::Six},   {SDLK_r, Key::D},    {SDLK_a, Key::Seven},
-    {SDLK_s, Key::Eight}, {SDLK_d, Key::Nine}, {SDLK_f, Key::E},
-    {SDLK_z, Key::A},     {SDLK_x, Key::Zero}, {SDLK_c, Key::B},
-    {SDLK_v, Key::F}};
-
-SDL_Keycode translateKeyToSDLKey(Key key) {
-  for (const auto &pair : keyMapping) {
-    if (pair.second == key) {
-      return pair.first;
-    }
-  }
-  return SDLK_UNKNOWN;
-}
-
-Key getKeyPressed() {
-  SDL_Event event;
-
-  if (SDL_WaitEvent(&event)) {
-    if (event.type == SDL_QUIT) {
-      exit(0);
-    }
-
-    if (event.type == SDL_KEYDOWN) {
-      auto it = keyMapping.find(event.key.keysym.sym);
-      if (it != keyMapping.end()) {
-        return it->second;
-      }
-    }
-  }
-
-  const Uint8 *keyboardState = SDL_GetKeyboardState(NULL);
-  for (const auto &pair : keyMapping) {
-    if (keyboardState[SDL_GetScancodeFromKey(pair.first)]) {
-      return pair.second;
-    }
-  }
-
-  return Key::Invalid;
-}
-
-void waitForKeyRelease(Key pressedKey) {
-  SDL_Event event;
-  const Uint8 *keyboardState = SDL_GetKeyboardState(NULL);
-  bool keyReleased = false;
-
-  while (!keyReleased) {
-    while (SDL_PollEvent(&event)) {
-      if (event.type == SDL_QUIT) {
-        exit(0);
-      }
-    }
-
-    for (const auto &pair : keyMapping) {
-      if (pair.second == pressedKey &&
-          !keyboardState[SDL_GetScancodeFromKey(pair.first)]) {
-        keyReleased = true;
-        break;
-      }
-    }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-  }
-}
-
-void setKeyPressed(uint16_t instruction, components::Registers &variableRegs) {
+void setKeyPressed(uint16_t instruction, components::Registers &variableRegs,
+                   components::Keypad &keypad, components::Memory &mem) {
   uint8_t X = (instruction & 0x0F00) >> 8;
 
-  Key key = Key::Invalid;
-  while (key == Key::Invalid) {
-    key = getKeyPressed();
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  // Completes once a key has been pressed and released; until then the
+  // instruction is re-executed so timers and rendering keep running.
+  uint8_t keyValue = keypad.takeReleasedKey();
+  if (keyValue == 0xFF) {
+    mem.setPC(mem.getPC() - 2);
+    return;
   }
 
-  waitForKeyRelease(key);
-
-  uint8_t keyValue = translateKeyToChar(key);
   variableRegs.setReg(X, keyValue);
 }
 
-void skipInst(uint16_t instruction, components::Registers &variableRegs,
-              components::Memory &mem) {
+Fault skipInst(uint16_t instruction, components::Registers &variableRegs,
+               components::Keypad &keypad, components::Memory &mem) {
   uint8_t x = (instruction & 0x0F00) >> 8;
   uint8_t code = (instruction & 0x00FF);
 
   uint8_t regValue = variableRegs.getReg(x);
-  Key expectedKey = static_cast<Key>(regValue);
-
-  SDL_Keycode keycode = translateKeyToSDLKey(expectedKey);
-  const Uint8 *keyboardState = SDL_GetKeyboardState(NULL);
-  bool isPressed = keyboardState[SDL_GetScancodeFromKey(keycode)];
+  bool isPressed = keypad.isPressed(regValue);
 
   if (code == 0x9E && isPressed) {
     mem.setPC(mem.getPC() + 2);
   } else if (code == 0xA1 && !isPressed) {
     mem.setPC(mem.getPC() + 2);
+  } else if (code != 0x9E && code != 0xA1) {
+    return Fault::IllegalOpcode;
   }
+  return Fault::None;
 }
 
 void fontCharacter(uint16_t instruction, components::Registers &variableRegs,
@@ -345,9 +288,12 @@ void fontCharacter(uint16_t instruction, components::Registers &variableRegs,
   indexReg = memoryPos;
 }
 
-void binaryDecimalConv(uint16_t instruction,
-                       components::Registers &variableRegs, uint16_t &indexReg,
-                       components::Memory &memory) {
+Fault binaryDecimalConv(uint16_t instruction,
+                        components::Registers &variableRegs,
+                        uint16_t &indexReg, components::Memory &memory) {
+  if (!inMemory(indexReg, 3)) {
+    return Fault::AddressOutOfRange;
+  }
   const uint8_t x = (instruction & 0x0F00) >> 8;
   uint8_t num = variableRegs.getReg(x);
   const uint8_t hundreds = num / 100;
@@ -357,27 +303,53 @@ void binaryDecimalConv(uint16_t instruction,
   memory.setByte(indexReg, hundreds);
   memory.setByte(indexReg + 1, tens);
   memory.setByte(indexReg + 2, ones);
+  return Fault::None;
 }
 
-void storeToMemory(uint16_t instruction, components::Registers &variableRegs,
-                   components::Memory &mem, uint16_t &indexReg) {
+Fault storeToMemory(uint16_t instruction, components::Registers &variableRegs,
+                    components::Memory &mem, uint16_t &indexReg) {
   const uint8_t x = (instruction & 0x0F00) >> 8;
+  if (!inMemory(indexReg, x + 1)) {
+    return Fault::AddressOutOfRange;
+  }
   for (uint8_t i = 0; i <= x; i++) {
     mem.setByte(indexReg + i, variableRegs.getReg(i));
   }
+  return Fault::None;
 }
 
-void loadFromMemory(uint16_t instruction, components::Registers &variableRegs,
-                    components::Memory &mem, uint16_t &indexReg) {
+Fault loadFromMemory(uint16_t instruction, components::Registers &variableRegs,
+                     components::Memory &mem, uint16_t &indexReg) {
   const uint8_t x = (instruction & 0x0F00) >> 8;
+  if (!inMemory(indexReg, x + 1)) {
+    return Fault::AddressOutOfRange;
+  }
   for (uint8_t i = 0; i <= x; i++) {
     variableRegs.setReg(i, mem.getByte(indexReg + i));
   }
+  return Fault::None;
 }
 
-void chooseFCodeFunc(uint16_t instruction, components::Registers &variableRegs,
-                     components::Memory &mem, uint16_t &indexReg,
-                     Timer &timerDelay, Timer &timerSound) {
+Fault chooseFCodeFunc(uint16_t instruction,
+                      components::Registers &variableRegs,
+                      components::Memory &mem, uint16_t &indexReg,
+                      Timer &timerDelay, Timer &timerSound,
+                      components::Keypad &keypad) {
+  switch (instruction & 0x00FF) {
+  case 0x07:
+  case 0x0A:
+  case 0x15:
+  case 0x18:
+  case 0x1E:
+  case 0x29:
+  case 0x33:
+  case 0x55:
+  case 0x65:
+    break;
+  default:
+    return Fault::IllegalOpcode;
+  }
+
   const uint8_t A = (instruction & 0x00F0) >> 4;
   const uint8_t B = instruction & 0x000F;
 
@@ -385,35 +357,32 @@ void chooseFCodeFunc(uint16_t instruction, components::Registers &variableRegs,
     if (B == 0x7) {
       modTimer(instruction, variableRegs, timerDelay);
     } else {
-      setKeyPressed(instruction, variableRegs);
+      setKeyPressed(instruction, variableRegs, keypad, mem);
     }
-    return;
+    return Fault::None;
   }
   if (A == 0x1) {
     if (B == 0x5) {
       modTimer(instruction, variableRegs, timerDelay);
-    }
-    if (B == 0x8) {
+    } else if (B == 0x8) {
       modTimer(instruction, variableRegs, timerSound);
     } else {
       addToIndex(instruction, variableRegs, indexReg);
     }
-    return;
+    return Fault::None;
   }
   if (A == 0x2) {
     fontCharacter(instruction, variableRegs, indexReg);
-    return;
+    return Fault::None;
   }
   if (A == 0x3) {
-    binaryDecimalConv(instruction, variableRegs, indexReg, mem);
-    return;
+    return binaryDecimalConv(instruction, variableRegs, indexReg, mem);
   }
   if (A == 0x5) {
-    storeToMemory(instruction, variableRegs, mem, indexReg);
-    return;
+    return storeToMemory(instruction, variableRegs, mem, indexReg);
   }
   if (A == 0x6) {
-    loadFromMemory(instruction, variableRegs, mem, indexReg);
-    return;
+    return loadFromMemory(instruction, variableRegs, mem, indexReg);
   }
-}
\ No newline at end of file
+  return Fault::None;
+}
@@ -5,39 +5,41 @@
 // 00E0
 void clearScreen(Display &display);
 // 00EE
-void retFromSubroutine(Memory &mem, std::stack<uint16_t> &stack);
+Fault retFromSubroutine(Memory &mem, std::stack<uint16_t> &stack);
 // 1NNN
 void jumpTo(uint16_t instruction, Memory &mem);
 // 2NNN
-void callSubroutine(uint16_t instruction, Memory &mem,
-                    std::stack<uint16_t> &stack);
+Fault callSubroutine(uint16_t instruction, Memory &mem,
+                     std::stack<uint16_t> &stack);
 // 3XNN, 4XNN, 5XY0 & 9XY0
-void conditional(uint16_t instruction, components::Registers &variableRegs,
-                 components::Memory &mem);
+Fault conditional(uint16_t instruction, components::Registers &variableRegs,
+                  components::Memory &mem);
 // 6XNN
 void setRegister(uint16_t instruction, components::Registers &variableRegs);
 // 7XNN
 void addInRegister(uint16_t instruction, components::Registers &variableRegs);
 // 8XYI
-void arithmetic(uint16_t instruction, components::Registers &variableRegs);
+Fault arithmetic(uint16_t instruction, components::Registers &variableRegs);
 // ANNN
 void setIndexRegister(uint16_t instruction, uint16_t &indexReg);
 // BNNN
 void jumpOffset(uint16_t instruction, components::Registers &variableRegs,
                 components::Memory &mem);
 // CXNN
-void random(uint16_t instruction, components::Registers &variableRegs);
+void random(uint16_t instruction, components::Registers &variableRegs,
+            components::Rng &rng);
 // DXYN
-void displaySprite(uint16_t instruction, components::Registers &variableRegs,
-                   components::Memory &mem, components::Display &display,
-                   uint16_t &indexReg);
+Fault displaySprite(uint16_t instruction, components::Registers &variableRegs,
+                    components::Memory &mem, components::Display &display,
+                    uint16_t &indexReg);
 // EX9E & EXA1
-void skipInst(uint16_t instruction, components::Registers &variableRegs,
-              components::Memory &mem);
+Fault skipInst(uint16_t instruction, components::Registers &variableRegs,
+               components::Keypad &keypad, components::Memory &mem);
 // Function to choose between all code F instructions
-void chooseFCodeFunc(uint16_t instruction, components::Registers &variableRegs,
-                     components::Memory &mem, uint16_t &indexReg,
-                     Timer &timerDelay, Timer &timerSound);
+Fault chooseFCodeFunc(uint16_t instruction, components::Registers &variableRegs,
+                      components::Memory &mem, uint16_t &indexReg,
+                      Timer &timerDelay, Timer &timerSound,
+                      components::Keypad &keypad);
 // FX007,FX15 & FX18
 void modTimer(uint16_t instruction, components::Registers &variableRegs,
               components::Timer &timer);
@@ -45,19 +47,18 @@ void modTimer(uint16_t instruction, components::Registers &variableRegs,
 void addToIndex(uint16_t instruction, components::Registers &variableRegs,
                 uint16_t &indexReg);
 // FX0A
-void setKeyPressed(uint16_t instruction, components::Registers &variableRegs);
+void setKeyPressed(uint16_t instruction, components::Registers &variableRegs,
+                   components::Keypad &keypad, components::Memory &mem);
 // FX29
 void fontCharacter(uint16_t instruction, components::Registers &variableRegs,
                    uint16_t &indexReg);
 // FX33
-void binaryDecimalConv(uint16_t instruction,
-                       components::Registers &variableRegs, uint16_t &indexReg,
-                       components::Memory &memory);
+Fault binaryDecimalConv(uint16_t instruction,
+                        components::Registers &variableRegs, uint16_t &indexReg,
+                        components::Memory &memory);
 //  FX55
-void storeToMemory(uint16_t instruction, components::Registers &variableRegs,
-                   components::Memory &mem, uint16_t &indexReg);
-// FX65
-void loadFromMemory(uint16_t instruction, components::Registers &variableRegs,
+Fault storeToMemory(uint16_t instruction, components::Registers &variableRegs,
                     components::Memory &mem, uint16_t &indexReg);
-// Util to make the program extract a pressed key
-Key getKeyPressed();
+// FX65
+Fault loadFromMemory(uint16_t instruction, components::Registers &variableRegs,
+                     components::Memory &mem, uint16_t &indexReg);
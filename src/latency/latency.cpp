@@ -0,0 +1,116 @@
+#include "latency.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+// Emulated frames after which an unanswered key event is given up on.
+const int ABANDON_FRAMES = 60;
+
+}  // namespace
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration) {
+  const uint64_t us = std::max<int64_t>(
+      0, std::chrono::duration_cast<std::chrono::microseconds>(duration)
+             .count());
+  size_t bucket = 0;
+  while (bucket + 1 < bucketCount && (uint64_t(1) << (bucket + 1)) <= us) {
+    bucket++;
+  }
+  buckets[bucket]++;
+  count++;
+  sumUs += us;
+  maxUs = std::max(maxUs, us);
+}
+
+uint64_t LatencyHistogram::getCount() const { return count; }
+
+uint64_t LatencyHistogram::quantile(double q) const {
+  const uint64_t target = static_cast<uint64_t>(q * count);
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+    seen += buckets[bucket];
+    if (seen > target) {
+      return std::min(uint64_t(2) << bucket, maxUs);
+    }
+  }
+  return maxUs;
+}
+
+void LatencyHistogram::print(std::ostream &out,
+                             const std::string &name) const {
+  out << "  " << std::left << std::setw(16) << name << std::right;
+  if (count == 0) {
+    out << "no samples" << std::endl;
+    return;
+  }
+  out << "n=" << count << " mean=" << sumUs / count << "us"
+      << " p50<=" << quantile(0.5) << "us"
+      << " p99<=" << quantile(0.99) << "us"
+      << " max=" << maxUs << "us" << std::endl;
+
+  const uint64_t peak = *std::max_element(buckets.begin(), buckets.end());
+  for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+    if (buckets[bucket] == 0) {
+      continue;
+    }
+    out << "    <" << std::setw(9) << (uint64_t(2) << bucket) << "us "
+        << std::setw(7) << buckets[bucket] << " "
+        << std::string((buckets[bucket] * 40 + peak - 1) / peak, '#')
+        << std::endl;
+  }
+}
+
+void LatencyTracker::keyEvent(uint8_t key, Clock::time_point when) {
+  if (stage != Stage::Idle || key > 0xF) {
+    return;
+  }
+  stage = Stage::Event;
+  keyMask = 1 << key;
+  eventTime = when;
+  framesWaited = 0;
+}
+
+void LatencyTracker::frameDone(uint16_t observedKeys, uint64_t displayHash,
+                               Clock::time_point when) {
+  const uint64_t previousHash = lastHash;
+  lastHash = displayHash;
+  if (stage == Stage::Idle || stage == Stage::Changed) {
+    return;
+  }
+
+  if (stage == Stage::Event && (observedKeys & keyMask)) {
+    // The frame ran in a burst just before `when`; that is as close to the
+    // reading instruction as the front-end can tell.
+    toRead.record(when - eventTime);
+    stage = Stage::Read;
+  }
+  // A frame that both read the key and changed the display counts.
+  if (stage == Stage::Read && displayHash != previousHash) {
+    toChange.record(when - eventTime);
+    stage = Stage::Changed;
+    return;
+  }
+
+  if (++framesWaited >= ABANDON_FRAMES) {
+    abandoned++;
+    stage = Stage::Idle;
+  }
+}
+
+void LatencyTracker::presented(Clock::time_point when) {
+  if (stage != Stage::Changed) {
+    return;
+  }
+  toPresent.record(when - eventTime);
+  stage = Stage::Idle;
+}
+
+void LatencyTracker::report(std::ostream &out) const {
+  out << "Input latency (" << abandoned
+      << " key events without a visible response):" << std::endl;
+  toRead.print(out, "key -> read");
+  toChange.print(out, "key -> change");
+  toPresent.print(out, "key -> present");
+}
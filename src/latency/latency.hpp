@@ -0,0 +1,63 @@
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Log2-bucketed histogram of durations in microseconds.
+class LatencyHistogram {
+public:
+  void record(std::chrono::nanoseconds duration);
+  uint64_t getCount() const;
+  // Upper bound of the bucket holding the given quantile (0..1), in us.
+  uint64_t quantile(double q) const;
+  void print(std::ostream &out, const std::string &name) const;
+
+private:
+  static const size_t bucketCount = 32;
+  std::array<uint64_t, bucketCount> buckets = {};
+  uint64_t count = 0;
+  uint64_t sumUs = 0;
+  uint64_t maxUs = 0;
+};
+
+// Follows one key event at a time from the host to the screen:
+//   event    -> read:    the first instruction that looks at the key
+//                        (EX9E/EXA1, or FX0A for any key)
+//   event    -> change:  the end of the first frame after that read which
+//                        changed the display
+//   event    -> present: the present call that showed that frame
+// Events arriving while one is in flight are not sampled. An event the guest
+// never reads, or that never changes the display, is dropped after a second.
+class LatencyTracker {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  void keyEvent(uint8_t key, Clock::time_point when);
+  // After every emulated frame, with Keypad::takeObserved() and the display
+  // hash of the frame.
+  void frameDone(uint16_t observedKeys, uint64_t displayHash,
+                 Clock::time_point when);
+  // After every present call.
+  void presented(Clock::time_point when);
+
+  void report(std::ostream &out) const;
+
+private:
+  enum class Stage { Idle, Event, Read, Changed };
+
+  Stage stage = Stage::Idle;
+  uint16_t keyMask = 0;
+  uint64_t lastHash = 0;
+  int framesWaited = 0;
+  uint64_t abandoned = 0;
+  Clock::time_point eventTime;
+  LatencyHistogram toRead;
+  LatencyHistogram toChange;
+  LatencyHistogram toPresent;
+};
+
+#endif  // LATENCY_HPP
@@ -0,0 +1,132 @@
+#include "options.hpp"
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program << " [options]\n"
+            << "  --rom-dir=PATH    directory to load the first .ch8 from\n"
+            << "  --ips=N           instructions per second (default 700)\n"
+            << "  --vip             COSMAC VIP instruction timing (ignores --ips)\n"
+            << "  --fuse            run common opcode sequences as superinstructions\n"
+            << "  --turbo[=N]       start in turbo mode, unlimited or at N times speed\n"
+            << "  --frameskip=N     in turbo, present every Nth frame\n"
+            << "  --palette=P       mono, amber, green, xochip or RRGGBB,RRGGBB\n"
+            << "  --persistence=F   phosphor persistence between 0 and 1\n"
+            << "  --gdb=PORT        serve the GDB remote protocol on localhost\n"
+            << "  --gdb=unix:PATH   ... or on a Unix socket\n"
+            << "  --headless        run without a window or input\n"
+            << "  --ansi            draw on the terminal instead of a window\n"
+            << "  --vsync           pace frames to the display refresh\n"
+            << "  --threaded        emulate on its own thread, render on the main one\n"
+            << "  --shadow[=N]      check against a reference interpreter, every frame\n"
+            << "                    or one frame per N instructions\n"
+            << "  --hud             show the performance overlay (F1 toggles)\n"
+            << "  --latency         report input-to-screen latency at exit\n"
+            << "  --profile=PREFIX  write a guest call-graph profile and heat map\n"
+            << "  --frames=N        stop after N emulated frames\n"
+            << "  --capture=F:PATH  record presented frames; F is pbm or png\n"
+            << "                    (PATH is a directory) or raw (RGB24 file,\n"
+            << "                    - for stdout)\n"
+            << "Press Tab to toggle turbo and F1 the overlay while running."
+            << std::endl;
+}
+
+bool parseInt(const std::string &text, int &value) {
+  try {
+    size_t used = 0;
+    value = std::stoi(text, &used);
+    return used == text.size() && value >= 0;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseInt(const std::string &text, long long &value) {
+  try {
+    size_t used = 0;
+    value = std::stoll(text, &used);
+    return used == text.size() && value >= 0;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseFloat(const std::string &text, float &value) {
+  try {
+    size_t used = 0;
+    value = std::stof(text, &used);
+    return used == text.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+}  // namespace
+
+bool parseOptions(int argc, char **argv, Options &opts) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+    bool ok = true;
+    if (name == "--rom-dir" && !value.empty()) {
+      opts.romDirectory = value;
+    } else if (name == "--ips") {
+      ok = parseInt(value, opts.instructionsPerSecond) &&
+           opts.instructionsPerSecond > 0;
+    } else if (name == "--vip" && value.empty()) {
+      opts.vip = true;
+    } else if (name == "--fuse" && value.empty()) {
+      opts.fuse = true;
+    } else if (name == "--turbo") {
+      opts.turbo = true;
+      ok = value.empty() || parseInt(value, opts.turboSpeed);
+    } else if (name == "--frameskip") {
+      ok = parseInt(value, opts.frameSkip);
+    } else if (name == "--palette" && !value.empty()) {
+      opts.palette = value;
+    } else if (name == "--persistence") {
+      ok = parseFloat(value, opts.persistence) && opts.persistence >= 0.0f &&
+           opts.persistence <= 1.0f;
+    } else if (name == "--gdb" && !value.empty()) {
+      opts.gdb = value;
+    } else if (name == "--headless" && value.empty()) {
+      opts.headless = true;
+    } else if (name == "--ansi" && value.empty()) {
+      opts.ansi = true;
+      opts.headless = true;
+    } else if (name == "--vsync" && value.empty()) {
+      opts.vsync = true;
+    } else if (name == "--threaded" && value.empty()) {
+      opts.threaded = true;
+    } else if (name == "--shadow") {
+      opts.shadow = true;
+      ok = value.empty() || (parseInt(value, opts.shadowInterval) &&
+                             opts.shadowInterval > 0);
+    } else if (name == "--hud" && value.empty()) {
+      opts.hud = true;
+    } else if (name == "--latency" && value.empty()) {
+      opts.latency = true;
+    } else if (name == "--profile" && !value.empty()) {
+      opts.profile = value;
+    } else if (name == "--frames") {
+      ok = parseInt(value, opts.maxFrames);
+    } else if (name == "--capture" && !value.empty()) {
+      opts.capture = value;
+    } else {
+      ok = false;
+    }
+
+    if (!ok) {
+      std::cerr << "Invalid argument: " << arg << std::endl;
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,56 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <string>
+
+// Command line settings of the emulator front-end.
+struct Options {
+  std::string romDirectory = "../binaries/";
+  int instructionsPerSecond = 700;
+  // Charge every instruction its COSMAC VIP cycle cost instead of running
+  // instructionsPerSecond.
+  bool vip = false;
+  // Run common opcode sequences as fused superinstructions and report how
+  // often each form ran at exit.
+  bool fuse = false;
+  // Fast-forward: run frames back to back instead of at 60 Hz.
+  bool turbo = false;
+  // Speed multiplier while in turbo; 0 runs as fast as the host allows.
+  int turboSpeed = 0;
+  // Present every Nth emulated frame while in turbo; 0 presents at the
+  // display refresh rate.
+  int frameSkip = 0;
+  // Run without a window or input; stops after maxFrames if non-zero.
+  bool headless = false;
+  long long maxFrames = 0;
+  // Named palette or list of RRGGBB colors, see parsePalette().
+  std::string palette = "mono";
+  // Phosphor persistence, fraction of brightness kept per frame (0 = off).
+  float persistence = 0.0f;
+  // GDB remote stub: TCP port on localhost or "unix:PATH"; empty disables.
+  std::string gdb;
+  // Draw on the terminal with ANSI escapes instead of an SDL window.
+  bool ansi = false;
+  // Present on vsync, running the frames due for each refresh as one batch
+  // right before it, with input polled just ahead of the last frame.
+  bool vsync = false;
+  // Emulate on a separate thread from event polling and presentation.
+  bool threaded = false;
+  // Check every frame (or, with shadowInterval, one frame per that many
+  // instructions) against a reference machine running the plain handlers.
+  bool shadow = false;
+  long long shadowInterval = 0;
+  // Show the performance overlay; F1 toggles it while running.
+  bool hud = false;
+  // Measure key-to-screen latency and print histograms at exit.
+  bool latency = false;
+  // Guest profile output prefix; empty disables profiling.
+  std::string profile;
+  // "pbm:DIR", "png:DIR" or "raw:FILE" ("-" for stdout); empty disables.
+  std::string capture;
+};
+
+// Parses argv into opts. Prints usage and returns false on bad input.
+bool parseOptions(int argc, char **argv, Options &opts);
+
+#endif  // OPTIONS_HPP
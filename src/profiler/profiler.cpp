@@ -0,0 +1,108 @@
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <string>
+
+#include "../cpu/cpu.hpp"
+#include "../cpu/timing.hpp"
+
+namespace {
+
+std::string frameName(uint16_t entry) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "sub_%03x", entry);
+  return buf;
+}
+
+}  // namespace
+
+Profiler::Profiler() { nodes.emplace_back(); }
+
+uint32_t Profiler::child(uint32_t parent, uint16_t entry) {
+  const uint64_t key = (uint64_t(parent) << 12) | entry;
+  auto it = children.find(key);
+  if (it != children.end()) {
+    return it->second;
+  }
+  Node node;
+  node.parent = parent;
+  node.entry = entry;
+  nodes.push_back(node);
+  const uint32_t index = nodes.size() - 1;
+  children.emplace(key, index);
+  return index;
+}
+
+void Profiler::record(uint16_t pc, uint32_t cycles, const Machine &machine) {
+  Node &node = nodes[current];
+  node.instructions++;
+  node.cycles += cycles;
+  heatInstructions[pc]++;
+  heatCycles[pc] += cycles;
+  instructions++;
+
+  // The instruction itself belongs to the caller on 2NNN and to the callee
+  // on 00EE; the path changes after it.
+  const size_t stackDepth = machine.stack.size();
+  if (stackDepth > depth) {
+    current = child(current, machine.mem.getPC());
+  } else if (stackDepth < depth && current != 0) {
+    current = nodes[current].parent;
+  }
+  depth = stackDepth;
+}
+
+void Profiler::writeFolded(std::ostream &out, bool cycles) const {
+  std::vector<std::string> names;
+  for (uint32_t index = 0; index < nodes.size(); ++index) {
+    const Node &node = nodes[index];
+    const uint64_t weight = cycles ? node.cycles : node.instructions;
+    if (weight == 0) {
+      continue;
+    }
+    names.clear();
+    for (uint32_t at = index; at != 0; at = nodes[at].parent) {
+      names.push_back(frameName(nodes[at].entry));
+    }
+    out << "main";
+    for (auto it = names.rbegin(); it != names.rend(); ++it) {
+      out << ';' << *it;
+    }
+    out << ' ' << weight << '\n';
+  }
+}
+
+void Profiler::writeHeatMap(std::ostream &out) const {
+  out << "address,instructions,cycles\n";
+  char address[8];
+  for (size_t pc = 0; pc < MEMORY_SIZE; ++pc) {
+    if (heatInstructions[pc] == 0) {
+      continue;
+    }
+    std::snprintf(address, sizeof(address), "0x%03zx", pc);
+    out << address << ',' << heatInstructions[pc] << ',' << heatCycles[pc]
+        << '\n';
+  }
+}
+
+uint64_t Profiler::getInstructions() const { return instructions; }
+
+size_t runFrameProfiled(Machine &machine, size_t budget, Profiler &profiler) {
+  size_t executed = 0;
+  while (executed < budget) {
+    const uint16_t pc = machine.mem.getPC();
+    uint32_t cycles = 0;
+    if (pc < MEMORY_SIZE - 1) {
+      // Costs depend on the state before the instruction runs.
+      cycles = vipCycles(
+          (machine.mem.getByte(pc) << 8) | machine.mem.getByte(pc + 1),
+          machine);
+    }
+    if (!step(machine)) {
+      break;
+    }
+    profiler.record(pc, cycles, machine);
+    ++executed;
+  }
+  return executed;
+}
@@ -0,0 +1,59 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "../cpu/machine.hpp"
+
+// Guest profiler. A shadow call stack follows the depth changes that
+// callSubroutine() and retFromSubroutine() make to the machine stack, and
+// every instruction is charged to the current call path and to its address.
+// Cycles are COSMAC VIP costs from vipCycles(), whatever the pacing mode.
+// Accounting is a few array increments per instruction; the trie of call
+// paths is only searched on 2NNN.
+class Profiler {
+public:
+  Profiler();
+
+  // Charges one instruction at pc, called with the machine state after it
+  // ran.
+  void record(uint16_t pc, uint32_t cycles, const Machine &machine);
+
+  // Folded stacks ("main;sub_2a4;sub_31e 1234" per line), weighted by
+  // cycles or by instructions, for flamegraph.pl and compatible tools.
+  void writeFolded(std::ostream &out, bool cycles) const;
+  // CSV of address, instructions and cycles for every executed address.
+  void writeHeatMap(std::ostream &out) const;
+
+  uint64_t getInstructions() const;
+
+private:
+  struct Node {
+    uint32_t parent = 0;
+    uint16_t entry = 0;
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+  };
+
+  uint32_t child(uint32_t parent, uint16_t entry);
+
+  std::vector<Node> nodes;
+  // (parent node << 12 | entry address) -> node.
+  std::unordered_map<uint64_t, uint32_t> children;
+  uint32_t current = 0;
+  size_t depth = 0;
+  std::array<uint64_t, MEMORY_SIZE> heatInstructions = {};
+  std::array<uint64_t, MEMORY_SIZE> heatCycles = {};
+  uint64_t instructions = 0;
+};
+
+// runFrame() with every instruction charged to the profiler. Idle loops are
+// executed rather than skipped, so the profile shows where the guest waits.
+size_t runFrameProfiled(Machine &machine, size_t budget, Profiler &profiler);
+
+#endif  // PROFILER_HPP
@@ -0,0 +1,236 @@
+#include "hud.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// 3x5 glyphs, one row per 3 bits from the top, left column in the high bit
+// of each row. The CHIP-8 hex font only covers 0-F, so this adds the rest
+// of the alphabet and a few symbols in a narrower cell.
+struct Glyph {
+  char c;
+  uint16_t rows;
+};
+
+constexpr uint16_t glyph(int r0, int r1, int r2, int r3, int r4) {
+  return (r0 << 12) | (r1 << 9) | (r2 << 6) | (r3 << 3) | r4;
+}
+
+const Glyph FONT[] = {
+    {'0', glyph(07, 05, 05, 05, 07)}, {'1', glyph(02, 06, 02, 02, 07)},
+    {'2', glyph(07, 01, 07, 04, 07)}, {'3', glyph(07, 01, 07, 01, 07)},
+    {'4', glyph(05, 05, 07, 01, 01)}, {'5', glyph(07, 04, 07, 01, 07)},
+    {'6', glyph(07, 04, 07, 05, 07)}, {'7', glyph(07, 01, 01, 01, 01)},
+    {'8', glyph(07, 05, 07, 05, 07)}, {'9', glyph(07, 05, 07, 01, 07)},
+    {'A', glyph(02, 05, 07, 05, 05)}, {'B', glyph(06, 05, 06, 05, 06)},
+    {'C', glyph(03, 04, 04, 04, 03)}, {'D', glyph(06, 05, 05, 05, 06)},
+    {'E', glyph(07, 04, 06, 04, 07)}, {'F', glyph(07, 04, 06, 04, 04)},
+    {'G', glyph(03, 04, 05, 05, 03)}, {'H', glyph(05, 05, 07, 05, 05)},
+    {'I', glyph(07, 02, 02, 02, 07)}, {'J', glyph(01, 01, 01, 05, 02)},
+    {'K', glyph(05, 05, 06, 05, 05)}, {'L', glyph(04, 04, 04, 04, 07)},
+    {'M', glyph(05, 07, 07, 05, 05)}, {'N', glyph(06, 05, 05, 05, 05)},
+    {'O', glyph(02, 05, 05, 05, 02)}, {'P', glyph(06, 05, 06, 04, 04)},
+    {'Q', glyph(02, 05, 05, 06, 03)}, {'R', glyph(06, 05, 06, 05, 05)},
+    {'S', glyph(03, 04, 02, 01, 06)}, {'T', glyph(07, 02, 02, 02, 02)},
+    {'U', glyph(05, 05, 05, 05, 07)}, {'V', glyph(05, 05, 05, 05, 02)},
+    {'W', glyph(05, 05, 07, 07, 05)}, {'X', glyph(05, 05, 02, 05, 05)},
+    {'Y', glyph(05, 05, 02, 02, 02)}, {'Z', glyph(07, 01, 02, 04, 07)},
+    {'.', glyph(00, 00, 00, 00, 02)}, {':', glyph(00, 02, 00, 02, 00)},
+    {'-', glyph(00, 00, 07, 00, 00)}, {'/', glyph(01, 01, 02, 04, 04)},
+    {'%', glyph(05, 01, 02, 04, 05)}, {'=', glyph(00, 07, 00, 07, 00)},
+};
+
+const int GLYPH_WIDTH = 3;
+const int GLYPH_HEIGHT = 5;
+const int CELL_WIDTH = GLYPH_WIDTH + 1;
+const int LINE_HEIGHT = GLYPH_HEIGHT + 2;
+const int MARGIN = 2;
+const int GRAPH_HEIGHT = 30;
+
+const uint32_t TEXT_COLOR = 0xFFFFFFFF;
+const uint32_t BAR_COLOR = 0xFF40C040;
+const uint32_t LATE_BAR_COLOR = 0xFFE04040;
+const uint32_t TARGET_COLOR = 0xFFE0E040;
+
+uint16_t lookupGlyph(char c) {
+  if (c >= 'a' && c <= 'z') {
+    c -= 'a' - 'A';
+  }
+  for (const Glyph &entry : FONT) {
+    if (entry.c == c) {
+      return entry.rows;
+    }
+  }
+  return 0;
+}
+
+uint32_t *row(uint32_t *dst, int pitch, int y) {
+  return reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(dst) +
+                                      size_t(y) * pitch);
+}
+
+}  // namespace
+
+Hud::Hud(std::string engine, std::string quirks,
+         std::chrono::nanoseconds targetFrameTime, int targetIps)
+    : engine(std::move(engine)),
+      quirks(std::move(quirks)),
+      target(targetFrameTime),
+      targetIps(targetIps) {}
+
+void Hud::toggle() { visible = !visible; }
+
+void Hud::emulated(Clock::duration duration, size_t executed) {
+  emulateTime += duration;
+  instructions += executed;
+}
+
+void Hud::rendered(Clock::duration duration) { renderTime += duration; }
+
+void Hud::slept(Clock::duration duration) { sleepTime += duration; }
+
+void Hud::late() { lateFrames++; }
+
+void Hud::dropped(int frames) { droppedFrames += frames; }
+
+void Hud::presented(Clock::time_point when) {
+  if (hasPresented) {
+    const Clock::duration interval = when - lastPresent;
+    presentTime += interval;
+    presents++;
+    graph[next] = std::chrono::duration_cast<std::chrono::microseconds>(
+                      interval)
+                      .count();
+    next = (next + 1) % GRAPH_SAMPLES;
+  }
+  lastPresent = when;
+  hasPresented = true;
+  roll(when);
+}
+
+void Hud::roll(Clock::time_point now) {
+  const Clock::duration window = now - windowStart;
+  if (window < std::chrono::seconds(1)) {
+    return;
+  }
+  const double seconds = std::chrono::duration<double>(window).count();
+  auto percent = [&](Clock::duration part) {
+    return 100.0 * std::chrono::duration<double>(part).count() / seconds;
+  };
+  ips = instructions / seconds;
+  frameMs = presents == 0 ? 0.0
+                          : std::chrono::duration<double, std::milli>(
+                                presentTime)
+                                    .count() /
+                                presents;
+  emulatePct = percent(emulateTime);
+  renderPct = percent(renderTime);
+  sleepPct = percent(sleepTime);
+
+  windowStart = now;
+  emulateTime = renderTime = sleepTime = presentTime = Clock::duration(0);
+  instructions = 0;
+  presents = 0;
+}
+
+void Hud::drawText(uint32_t *dst, int pitch, int x, int y,
+                   const std::string &text) const {
+  for (char c : text) {
+    if (x + GLYPH_WIDTH > WIDTH) {
+      return;
+    }
+    const uint16_t rows = lookupGlyph(c);
+    for (int gy = 0; gy < GLYPH_HEIGHT; ++gy) {
+      uint32_t *line = row(dst, pitch, y + gy) + x;
+      const int bits = (rows >> (3 * (GLYPH_HEIGHT - 1 - gy))) & 07;
+      for (int gx = 0; gx < GLYPH_WIDTH; ++gx) {
+        if (bits & (04 >> gx)) {
+          line[gx] = TEXT_COLOR;
+        }
+      }
+    }
+    x += CELL_WIDTH;
+  }
+}
+
+uint32_t *Hud::pixels() { return expanded.data(); }
+
+void Hud::compose(uint32_t *dst, int pitch) {
+  const int cols = components::Display::cols;
+  const int rows = components::Display::rows;
+  for (int y = 0; y < rows; ++y) {
+    uint32_t *first = row(dst, pitch, y * SCALE);
+    for (int x = 0; x < cols; ++x) {
+      std::fill_n(first + x * SCALE, SCALE, expanded[y * cols + x]);
+    }
+    for (int copy = 1; copy < SCALE; ++copy) {
+      std::memcpy(row(dst, pitch, y * SCALE + copy), first,
+                  WIDTH * sizeof(uint32_t));
+    }
+  }
+  if (!visible) {
+    return;
+  }
+
+  char buf[96];
+  std::string lines[6];
+  std::snprintf(buf, sizeof(buf), "IPS %llu",
+                static_cast<unsigned long long>(ips));
+  lines[0] = buf;
+  if (targetIps > 0) {
+    lines[0] += " / " + std::to_string(targetIps);
+  }
+  std::snprintf(buf, sizeof(buf), "FRAME %.1f / %.1f MS", frameMs,
+                std::chrono::duration<double, std::milli>(target).count());
+  lines[1] = buf;
+  std::snprintf(buf, sizeof(buf), "EMU %.1f%% REN %.1f%% SLP %.1f%%",
+                emulatePct, renderPct, sleepPct);
+  lines[2] = buf;
+  std::snprintf(buf, sizeof(buf), "LATE %llu DROP %llu",
+                static_cast<unsigned long long>(lateFrames),
+                static_cast<unsigned long long>(droppedFrames));
+  lines[3] = buf;
+  lines[4] = "ENGINE " + engine;
+  lines[5] = quirks;
+
+  // Darken the box behind the text and graph so it reads on any frame.
+  size_t longest = 0;
+  for (const std::string &line : lines) {
+    longest = std::max(longest, line.size());
+  }
+  const int boxWidth = std::min<int>(
+      WIDTH, std::max<int>(longest * CELL_WIDTH, GRAPH_SAMPLES) + 2 * MARGIN);
+  const int graphTop = MARGIN + 6 * LINE_HEIGHT;
+  const int boxHeight = graphTop + GRAPH_HEIGHT + MARGIN;
+  for (int y = 0; y < boxHeight; ++y) {
+    uint32_t *line = row(dst, pitch, y);
+    for (int x = 0; x < boxWidth; ++x) {
+      line[x] = 0xFF000000 | ((line[x] >> 3) & 0x001F1F1F);
+    }
+  }
+  for (int i = 0; i < 6; ++i) {
+    drawText(dst, pitch, MARGIN, MARGIN + i * LINE_HEIGHT, lines[i]);
+  }
+
+  // Frame-time graph, oldest sample on the left. The target frame time sits
+  // at half height and bars clip at twice the target.
+  const uint32_t targetUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(target).count();
+  for (size_t i = 0; i < GRAPH_SAMPLES; ++i) {
+    const uint32_t sample = graph[(next + i) % GRAPH_SAMPLES];
+    const int height = std::min<uint64_t>(
+        GRAPH_HEIGHT, uint64_t(sample) * GRAPH_HEIGHT / (2 * targetUs));
+    const uint32_t color =
+        sample * 2 > targetUs * 3 ? LATE_BAR_COLOR : BAR_COLOR;
+    for (int y = 0; y < height; ++y) {
+      row(dst, pitch, graphTop + GRAPH_HEIGHT - 1 - y)[MARGIN + i] = color;
+    }
+  }
+  uint32_t *targetLine = row(dst, pitch, graphTop + GRAPH_HEIGHT / 2);
+  for (size_t x = 0; x < GRAPH_SAMPLES; x += 2) {
+    targetLine[MARGIN + x] = TARGET_COLOR;
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef HUD_HPP
+#define HUD_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../components/components.hpp"
+
+// Performance overlay drawn into the frame texture. The front-end reports
+// where each frame's time went; once a second the totals become the rates
+// shown. Text uses a 3x5 pixel font, so the texture is SCALE times the
+// CHIP-8 resolution: the frame is expanded into pixels() and compose()
+// upscales it into the texture before drawing the overlay on top.
+class Hud {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static const int SCALE = 5;
+  static const int WIDTH = components::Display::cols * SCALE;
+  static const int HEIGHT = components::Display::rows * SCALE;
+
+  // targetIps is shown next to the measured rate unless it is 0.
+  Hud(std::string engine, std::string quirks,
+      std::chrono::nanoseconds targetFrameTime, int targetIps);
+
+  void toggle();
+
+  void emulated(Clock::duration duration, size_t instructions);
+  void rendered(Clock::duration duration);
+  void slept(Clock::duration duration);
+  // A frame started after its deadline.
+  void late();
+  // Emulated frames that were never presented.
+  void dropped(int frames);
+  void presented(Clock::time_point when);
+
+  // Display::rows rows of Display::cols ARGB pixels, packed.
+  uint32_t *pixels();
+  // dst is a WIDTH x HEIGHT texture, pitch bytes per row.
+  void compose(uint32_t *dst, int pitch);
+
+private:
+  static const size_t GRAPH_SAMPLES = 120;
+
+  void roll(Clock::time_point now);
+  void drawText(uint32_t *dst, int pitch, int x, int y,
+                const std::string &text) const;
+
+  std::array<uint32_t, components::Display::rows * components::Display::cols>
+      expanded = {};
+  std::string engine;
+  std::string quirks;
+  std::chrono::nanoseconds target;
+  int targetIps;
+  bool visible = true;
+
+  // Totals of the current one-second window.
+  Clock::time_point windowStart = Clock::now();
+  Clock::duration emulateTime{0};
+  Clock::duration renderTime{0};
+  Clock::duration sleepTime{0};
+  uint64_t instructions = 0;
+  uint64_t presents = 0;
+  Clock::duration presentTime{0};
+
+  // Values shown, refreshed once per window.
+  uint64_t ips = 0;
+  double frameMs = 0.0;
+  double emulatePct = 0.0;
+  double renderPct = 0.0;
+  double sleepPct = 0.0;
+  uint64_t lateFrames = 0;
+  uint64_t droppedFrames = 0;
+
+  Clock::time_point lastPresent;
+  bool hasPresented = false;
+  // Present-to-present intervals in microseconds, oldest first from next.
+  std::array<uint32_t, GRAPH_SAMPLES> graph = {};
+  size_t next = 0;
+};
+
+#endif  // HUD_HPP
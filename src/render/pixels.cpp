@@ -0,0 +1,216 @@
+#include "pixels.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXELS_X86 1
+#endif
+
+namespace {
+
+const size_t WIDTH = components::Display::cols;
+const size_t HEIGHT = components::Display::rows;
+
+using Frame = components::Display::Frame;
+
+// Lit pixels go to full intensity, the others are scaled by decay / 256.
+void updateScalar(const Frame &frame, uint8_t *intensity, uint8_t decay) {
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    for (size_t col = 0; col < WIDTH; ++col) {
+      uint8_t &level = intensity[row * WIDTH + col];
+      const bool lit = (frame[row] >> (WIDTH - 1 - col)) & 1;
+      level = lit ? 0xFF : (level * decay) >> 8;
+    }
+  }
+}
+
+void expandScalar(const uint8_t *intensity, const uint32_t *lut,
+                  uint32_t *dst, int pitch) {
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    uint32_t *line = reinterpret_cast<uint32_t *>(
+        reinterpret_cast<uint8_t *>(dst) + row * pitch);
+    for (size_t col = 0; col < WIDTH; ++col) {
+      line[col] = lut[intensity[row * WIDTH + col]];
+    }
+  }
+}
+
+#ifdef PIXELS_X86
+
+// 16 pixels per step: both bytes of the row's 16-bit slice are broadcast into
+// one half of the register each and tested against one bit per lane.
+void updateSse2(const Frame &frame, uint8_t *intensity, uint8_t decay) {
+  const __m128i bits = _mm_setr_epi8(
+      char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, char(0x80), 0x40,
+      0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i factor = _mm_set1_epi16(decay);
+
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    for (size_t chunk = 0; chunk < WIDTH / 16; ++chunk) {
+      const uint16_t word = frame[row] >> (48 - 16 * chunk);
+      const __m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8(char(word >> 8)),
+                                                _mm_set1_epi8(char(word)));
+      const __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+
+      uint8_t *levels = intensity + row * WIDTH + chunk * 16;
+      const __m128i current =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(levels));
+      const __m128i lo = _mm_srli_epi16(
+          _mm_mullo_epi16(_mm_unpacklo_epi8(current, zero), factor), 8);
+      const __m128i hi = _mm_srli_epi16(
+          _mm_mullo_epi16(_mm_unpackhi_epi8(current, zero), factor), 8);
+      const __m128i decayed = _mm_packus_epi16(lo, hi);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(levels),
+                       _mm_or_si128(decayed, lit));
+    }
+  }
+}
+
+// Same as updateSse2 on 32 pixels per step. unpack/pack work within each
+// 128-bit lane, so the pixel order is preserved.
+__attribute__((target("avx2"))) void updateAvx2(const Frame &frame,
+                                                uint8_t *intensity,
+                                                uint8_t decay) {
+  const __m256i bits = _mm256_set1_epi64x(0x0102040810204080LL);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i factor = _mm256_set1_epi16(decay);
+  const uint64_t spread = 0x0101010101010101ULL;
+
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    for (size_t chunk = 0; chunk < WIDTH / 32; ++chunk) {
+      const uint32_t word = frame[row] >> (32 - 32 * chunk);
+      const __m256i bytes = _mm256_setr_epi64x(
+          ((word >> 24) & 0xFF) * spread, ((word >> 16) & 0xFF) * spread,
+          ((word >> 8) & 0xFF) * spread, (word & 0xFF) * spread);
+      const __m256i lit =
+          _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+
+      uint8_t *levels = intensity + row * WIDTH + chunk * 32;
+      const __m256i current =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(levels));
+      const __m256i lo = _mm256_srli_epi16(
+          _mm256_mullo_epi16(_mm256_unpacklo_epi8(current, zero), factor), 8);
+      const __m256i hi = _mm256_srli_epi16(
+          _mm256_mullo_epi16(_mm256_unpackhi_epi8(current, zero), factor), 8);
+      const __m256i decayed = _mm256_packus_epi16(lo, hi);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(levels),
+                          _mm256_or_si256(decayed, lit));
+    }
+  }
+}
+
+// Palette lookup for 8 pixels at a time with a gather.
+__attribute__((target("avx2"))) void expandAvx2(const uint8_t *intensity,
+                                                const uint32_t *lut,
+                                                uint32_t *dst, int pitch) {
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    uint32_t *line = reinterpret_cast<uint32_t *>(
+        reinterpret_cast<uint8_t *>(dst) + row * pitch);
+    for (size_t col = 0; col < WIDTH; col += 8) {
+      const __m128i levels = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i *>(intensity + row * WIDTH + col));
+      const __m256i colors = _mm256_i32gather_epi32(
+          reinterpret_cast<const int *>(lut), _mm256_cvtepu8_epi32(levels),
+          4);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(line + col), colors);
+    }
+  }
+}
+
+#endif  // PIXELS_X86
+
+using UpdateFn = void (*)(const Frame &, uint8_t *, uint8_t);
+using ExpandFn = void (*)(const uint8_t *, const uint32_t *, uint32_t *, int);
+
+struct Kernels {
+  UpdateFn update;
+  ExpandFn expand;
+};
+
+Kernels selectKernels() {
+#ifdef PIXELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {updateAvx2, expandAvx2};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return {updateSse2, expandScalar};
+  }
+#endif
+  return {updateScalar, expandScalar};
+}
+
+uint32_t blend(uint32_t from, uint32_t to, uint8_t level) {
+  uint32_t result = 0xFF000000;
+  for (int shift = 0; shift < 24; shift += 8) {
+    const uint32_t a = (from >> shift) & 0xFF;
+    const uint32_t b = (to >> shift) & 0xFF;
+    result |= ((a * (255 - level) + b * level + 127) / 255) << shift;
+  }
+  return result;
+}
+
+}  // namespace
+
+bool parsePalette(const std::string &spec, Palette &palette) {
+  if (spec == "mono") {
+    palette = {{0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555}};
+  } else if (spec == "amber") {
+    palette = {{0xFF1A0F00, 0xFFFFB000, 0xFFCC7A00, 0xFF663D00}};
+  } else if (spec == "green") {
+    palette = {{0xFF001A00, 0xFF33FF33, 0xFF22AA22, 0xFF115511}};
+  } else if (spec == "xochip") {
+    // Octo's default XO-CHIP colors.
+    palette = {{0xFF996600, 0xFFFFCC00, 0xFFFF6600, 0xFF662200}};
+  } else {
+    std::stringstream ss(spec);
+    std::string item;
+    size_t count = 0;
+    while (std::getline(ss, item, ',')) {
+      if (count == palette.colors.size() || item.size() != 6 ||
+          item.find_first_not_of("0123456789abcdefABCDEF") !=
+              std::string::npos) {
+        return false;
+      }
+      palette.colors[count++] = 0xFF000000 | std::stoul(item, nullptr, 16);
+    }
+    if (count < 2) {
+      return false;
+    }
+    // Unspecified plane colors fall back to the foreground.
+    for (; count < palette.colors.size(); ++count) {
+      palette.colors[count] = palette.colors[1];
+    }
+  }
+  return true;
+}
+
+PixelExpander::PixelExpander() {
+  parsePalette("mono", palette);
+  rebuildLut();
+}
+
+void PixelExpander::setPalette(const Palette &newPalette) {
+  palette = newPalette;
+  rebuildLut();
+}
+
+void PixelExpander::setPersistence(float persistence) {
+  decay = static_cast<uint8_t>(std::clamp(persistence, 0.0f, 1.0f) * 255);
+}
+
+void PixelExpander::rebuildLut() {
+  for (size_t level = 0; level < lut.size(); ++level) {
+    lut[level] = blend(palette.colors[0], palette.colors[1], level);
+  }
+}
+
+void PixelExpander::expand(const components::Display::Frame &frame,
+                           uint32_t *dst, int pitch) {
+  static const Kernels kernels = selectKernels();
+  kernels.update(frame, intensity.data(), decay);
+  kernels.expand(intensity.data(), lut.data(), dst, pitch);
+}
@@ -0,0 +1,47 @@
+#ifndef PIXELS_HPP
+#define PIXELS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "../components/components.hpp"
+
+// Colors as 0xAARRGGBB, indexed by plane bits (bit 0 = first plane). CHIP-8
+// only has one plane and uses the first two entries; XO-CHIP palettes carry
+// all four.
+struct Palette {
+  std::array<uint32_t, 4> colors;
+};
+
+// Looks up a named palette ("mono", "amber", "green", "xochip") or parses a
+// list of 2 to 4 comma separated RRGGBB colors.
+bool parsePalette(const std::string &spec, Palette &palette);
+
+// Turns the 1bpp framebuffer into ARGB8888 pixels, e.g. straight into a
+// locked streaming texture. Each pixel keeps a phosphor intensity that is set
+// to full when lit and decays by the persistence factor every frame after,
+// which hides the flicker of XOR-drawn sprites. The per-pixel work runs on
+// AVX2 or SSE2 when the CPU has them, with a scalar fallback.
+class PixelExpander {
+public:
+  PixelExpander();
+
+  void setPalette(const Palette &palette);
+  // Fraction of intensity kept per frame, 0 (off) to 1.
+  void setPersistence(float persistence);
+  // dst holds Display::rows rows of Display::cols pixels, pitch bytes apart.
+  void expand(const components::Display::Frame &frame, uint32_t *dst,
+              int pitch);
+
+private:
+  void rebuildLut();
+
+  Palette palette;
+  uint8_t decay = 0;
+  std::array<uint32_t, 256> lut;
+  alignas(32) std::array<uint8_t, components::Display::rows *
+                                      components::Display::cols> intensity = {};
+};
+
+#endif  // PIXELS_HPP
@@ -0,0 +1,86 @@
+#include "terminal.hpp"
+
+#include <cerrno>
+#include <cstdint>
+
+namespace {
+
+const size_t COLS = components::Display::cols;
+const size_t CELL_ROWS = components::Display::rows / 2;
+
+// Indexed by (top << 1) | bottom.
+const char *const GLYPHS[4] = {" ", "▄", "▀", "█"};
+
+}  // namespace
+
+TerminalRenderer::TerminalRenderer(int fd) : fd(fd) {
+  out.reserve(COLS * CELL_ROWS * 8);
+  // Hide the cursor and start from a clean screen.
+  out = "\x1b[?25l\x1b[2J";
+  flush();
+}
+
+TerminalRenderer::~TerminalRenderer() {
+  // Leave the cursor below the picture and visible again.
+  out = "\x1b[" + std::to_string(CELL_ROWS + 1) + ";1H\x1b[0m\x1b[?25h";
+  flush();
+}
+
+void TerminalRenderer::invalidate() { hasPrevious = false; }
+
+void TerminalRenderer::present(const components::Display &disp) {
+  const components::Display::Frame &frame = disp.getFrame();
+  out.clear();
+
+  // Position the cursor lands on after the last glyph, so runs of changed
+  // cells need a single move.
+  size_t cursorRow = SIZE_MAX;
+  size_t cursorCol = SIZE_MAX;
+
+  for (size_t cell = 0; cell < CELL_ROWS; ++cell) {
+    const uint64_t top = frame[2 * cell];
+    const uint64_t bottom = frame[2 * cell + 1];
+    uint64_t changed = ~uint64_t(0);
+    if (hasPrevious) {
+      changed = (top ^ previous[2 * cell]) | (bottom ^ previous[2 * cell + 1]);
+    }
+
+    while (changed) {
+      const size_t bit = 63 - __builtin_clzll(changed);
+      changed &= ~(uint64_t(1) << bit);
+      const size_t col = COLS - 1 - bit;
+
+      if (cursorRow != cell || cursorCol != col) {
+        out += "\x1b[";
+        out += std::to_string(cell + 1);
+        out += ';';
+        out += std::to_string(col + 1);
+        out += 'H';
+      }
+      out += GLYPHS[(((top >> bit) & 1) << 1) | ((bottom >> bit) & 1)];
+      cursorRow = cell;
+      cursorCol = col + 1;
+    }
+  }
+
+  previous = frame;
+  hasPrevious = true;
+  flush();
+}
+
+void TerminalRenderer::flush() {
+  size_t offset = 0;
+  while (offset < out.size()) {
+    const ssize_t n = ::write(fd, out.data() + offset, out.size() - offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // The terminal went away; force a full redraw if it comes back.
+      hasPrevious = false;
+      break;
+    }
+    offset += n;
+  }
+  out.clear();
+}
@@ -0,0 +1,33 @@
+#ifndef TERMINAL_HPP
+#define TERMINAL_HPP
+
+#include <string>
+#include <unistd.h>
+
+#include "../components/components.hpp"
+
+// Draws the display on an ANSI terminal. Each character cell packs two pixel
+// rows using half-block glyphs, so the screen fits in 64x16 cells. Only cells
+// that changed since the previous frame are emitted, with cursor-addressing
+// escapes, and each frame goes out in a single write().
+class TerminalRenderer {
+public:
+  explicit TerminalRenderer(int fd = STDOUT_FILENO);
+  ~TerminalRenderer();
+  TerminalRenderer(const TerminalRenderer &) = delete;
+  TerminalRenderer &operator=(const TerminalRenderer &) = delete;
+
+  void present(const components::Display &disp);
+  // Forgets the previous frame so the next present() redraws everything.
+  void invalidate();
+
+private:
+  void flush();
+
+  int fd;
+  std::string out;
+  components::Display::Frame previous = {};
+  bool hasPrevious = false;
+};
+
+#endif  // TERMINAL_HPP
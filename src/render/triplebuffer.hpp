@@ -0,0 +1,48 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer triple buffer. The writer fills
+// back() and publishes it; the reader picks up the most recent published
+// value with update() and reads front(). Each side owns one slot and the
+// third is swapped between them with a single atomic exchange, so neither
+// side ever waits for the other and stale frames are simply overwritten.
+template <typename T> class TripleBuffer {
+public:
+  T &back() { return slots[backIndex].value; }
+
+  void publish() {
+    backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) &
+                INDEX;
+  }
+
+  // Returns true if a new value was published since the last call.
+  bool update() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+      return false;
+    }
+    frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  const T &front() const { return slots[frontIndex].value; }
+
+private:
+  static const uint8_t INDEX = 0x3;
+  static const uint8_t FRESH = 0x4;
+
+  // Separate cache lines so the two threads do not share one while writing.
+  struct alignas(64) Slot {
+    T value{};
+  };
+
+  std::array<Slot, 3> slots;
+  std::atomic<uint8_t> middle{1};
+  uint8_t backIndex = 0;
+  uint8_t frontIndex = 2;
+};
+
+#endif  // TRIPLEBUFFER_HPP
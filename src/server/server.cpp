@@ -0,0 +1,464 @@
+#include "server.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const int FRAMES_PER_SECOND = 60;
+// Messages are dropped for a session whose unsent output exceeds this.
+const size_t MAX_BACKLOG = 64 * 1024;
+// Frames a paused session can have queued by STEP.
+const long MAX_PENDING_STEPS = 600;
+// Frames to catch up at most after the loop fell behind.
+const uint64_t MAX_CATCH_UP = 4;
+
+void putU16(std::string &out, uint16_t value) {
+  out += static_cast<char>(value & 0xFF);
+  out += static_cast<char>(value >> 8);
+}
+
+void putU32(std::string &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out += static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+void putU64(std::string &out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out += static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+}  // namespace
+
+Server::Server(std::vector<char> rom, int instructionsPerSecond,
+               uint64_t shadowInterval)
+    : rom(std::move(rom)),
+      instructionsPerSecond(instructionsPerSecond),
+      shadowInterval(shadowInterval) {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeFd;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+  ev.data.fd = timerFd;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev);
+}
+
+Server::~Server() {
+  for (auto &entry : sessions) {
+    close(entry.first);
+  }
+  for (int fd : {listenFd, timerFd, wakeFd, epollFd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  if (!unixPath.empty()) {
+    unlink(unixPath.c_str());
+  }
+}
+
+bool Server::startListening(int fd) {
+  if (listen(fd, 128) < 0) {
+    std::cerr << "listen failed: " << std::strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+  setNonBlocking(fd);
+  listenFd = fd;
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = listenFd;
+  return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) == 0;
+}
+
+bool Server::listenTcp(int port) {
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  const int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    std::cerr << "Cannot bind port " << port << ": " << std::strerror(errno)
+              << std::endl;
+    close(fd);
+    return false;
+  }
+  return startListening(fd);
+}
+
+bool Server::listenUnix(const std::string &path) {
+  sockaddr_un addr = {};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    std::cerr << "Cannot bind " << path << ": " << std::strerror(errno)
+              << std::endl;
+    close(fd);
+    return false;
+  }
+  unixPath = path;
+  return startListening(fd);
+}
+
+void Server::stop() {
+  running = false;
+  const uint64_t one = 1;
+  [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+}
+
+void Server::run() {
+  itimerspec period = {};
+  period.it_interval.tv_nsec = 1000000000 / FRAMES_PER_SECOND;
+  period.it_value = period.it_interval;
+  timerfd_settime(timerFd, 0, &period, nullptr);
+
+  running = true;
+  epoll_event events[256];
+  while (running) {
+    const int count = epoll_wait(epollFd, events, 256, -1);
+    if (count < 0 && errno != EINTR) {
+      std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == listenFd) {
+        acceptClients();
+      } else if (fd == timerFd) {
+        tick();
+      } else if (fd == wakeFd) {
+        uint64_t value;
+        [[maybe_unused]] ssize_t n = read(wakeFd, &value, sizeof(value));
+      } else {
+        auto it = sessions.find(fd);
+        if (it == sessions.end()) {
+          continue;
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+          closeSession(fd);
+          continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+          onWritable(*it->second);
+        }
+        // The session may have been closed by the write.
+        it = sessions.find(fd);
+        if (it != sessions.end() && (events[i].events & EPOLLIN)) {
+          onReadable(*it->second);
+        }
+      }
+    }
+  }
+}
+
+void Server::acceptClients() {
+  while (true) {
+    const int fd = accept4(listenFd, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+
+    auto session = std::make_unique<Session>();
+    session->fd = fd;
+    resetMachine(*session);
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      close(fd);
+      continue;
+    }
+    sessions[fd] = std::move(session);
+  }
+}
+
+void Server::resetMachine(Session &session) {
+  session.machine = Machine();
+  session.machine.mem.loadIntoMemory(rom);
+  session.frame = 0;
+  session.hasSent = false;
+  if (shadowInterval > 0) {
+    session.shadow = std::make_unique<ShadowValidator>(shadowInterval);
+  }
+}
+
+void Server::onReadable(Session &session) {
+  char buf[4096];
+  while (true) {
+    const ssize_t n = recv(session.fd, buf, sizeof(buf), 0);
+    if (n == 0) {
+      closeSession(session.fd);
+      return;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN) {
+        closeSession(session.fd);
+        return;
+      }
+      break;
+    }
+    session.in.append(buf, n);
+  }
+
+  size_t newline;
+  while ((newline = session.in.find('\n')) != std::string::npos) {
+    std::string line = session.in.substr(0, newline);
+    session.in.erase(0, newline + 1);
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    handleCommand(session, line);
+  }
+  if (session.in.size() > 4096) {
+    // No sane command is this long.
+    closeSession(session.fd);
+    return;
+  }
+  flush(session);
+}
+
+void Server::handleCommand(Session &session, const std::string &line) {
+  const size_t space = line.find(' ');
+  const std::string command = line.substr(0, space);
+  const std::string arg =
+      space == std::string::npos ? "" : line.substr(space + 1);
+
+  if (command == "KEYS") {
+    char *end = nullptr;
+    const unsigned long mask = std::strtoul(arg.c_str(), &end, 16);
+    if (arg.empty() || *end != '\0' || mask > 0xFFFF) {
+      queueError(session, "bad key mask");
+      return;
+    }
+    for (uint8_t key = 0; key < 16; ++key) {
+      session.machine.keypad.setKey(key, (mask >> key) & 1);
+    }
+  } else if (command == "PAUSE") {
+    session.paused = true;
+  } else if (command == "RESUME") {
+    session.paused = false;
+    session.pendingSteps = 0;
+  } else if (command == "STEP") {
+    if (!session.paused) {
+      queueError(session, "STEP needs PAUSE");
+      return;
+    }
+    char *end = nullptr;
+    const long steps = arg.empty() ? 1 : std::strtol(arg.c_str(), &end, 10);
+    if (steps <= 0 || (end && *end != '\0')) {
+      queueError(session, "bad step count");
+      return;
+    }
+    session.pendingSteps = std::min<long>(
+        session.pendingSteps + std::min(steps, MAX_PENDING_STEPS),
+        MAX_PENDING_STEPS);
+  } else if (command == "SNAPSHOT") {
+    queueSnapshot(session);
+  } else if (command == "RESET") {
+    resetMachine(session);
+  } else if (!command.empty()) {
+    queueError(session, "unknown command");
+  }
+}
+
+void Server::tick() {
+  uint64_t expirations = 0;
+  if (read(timerFd, &expirations, sizeof(expirations)) !=
+      sizeof(expirations)) {
+    return;
+  }
+  const uint64_t frames = std::min(expirations, MAX_CATCH_UP);
+
+  for (auto &entry : sessions) {
+    Session &session = *entry.second;
+    for (uint64_t i = 0; i < frames; ++i) {
+      if (!session.paused) {
+        runSessionFrame(session);
+      } else if (session.pendingSteps > 0) {
+        session.pendingSteps--;
+        runSessionFrame(session);
+      }
+    }
+    queueDelta(session);
+  }
+  // flush() may close sessions, so do not iterate the map while flushing.
+  std::vector<int> pending;
+  for (auto &entry : sessions) {
+    if (!entry.second->out.empty()) {
+      pending.push_back(entry.first);
+    }
+  }
+  for (int fd : pending) {
+    auto it = sessions.find(fd);
+    if (it != sessions.end()) {
+      flush(*it->second);
+    }
+  }
+}
+
+void Server::runSessionFrame(Session &session) {
+  if (session.machine.fault != Fault::None) {
+    return;
+  }
+  const uint64_t ips = instructionsPerSecond;
+  const size_t budget = (ips * (session.frame + 1)) / FRAMES_PER_SECOND -
+                        (ips * session.frame) / FRAMES_PER_SECOND;
+  if (session.shadow) {
+    session.shadow->beginFrame(session.machine);
+  }
+  const size_t executed = runFrame(session.machine, budget, session.idle);
+  if (session.shadow &&
+      !session.shadow->endFrame(session.machine, executed)) {
+    std::cerr << "Session " << session.fd << ": "
+              << session.shadow->getReport();
+    session.shadow.reset();
+  }
+  if (session.machine.fault != Fault::None) {
+    queueError(session, "fault: " + describeFault(session.machine));
+    return;
+  }
+  session.frame++;
+
+  session.machine.keypad.clearReleased();
+  session.machine.timerDelay.tick();
+  session.machine.timerSound.tick();
+}
+
+void Server::queueDelta(Session &session) {
+  if (session.out.size() > MAX_BACKLOG) {
+    return;
+  }
+
+  const components::Display::Frame &frame = session.machine.disp.getFrame();
+  uint32_t changed = 0;
+  for (size_t row = 0; row < frame.size(); ++row) {
+    if (!session.hasSent || frame[row] != session.sent[row]) {
+      changed |= uint32_t(1) << row;
+    }
+  }
+  if (changed == 0) {
+    return;
+  }
+
+  session.out += 'F';
+  putU32(session.out, session.frame);
+  putU32(session.out, changed);
+  for (size_t row = 0; row < frame.size(); ++row) {
+    if (changed & (uint32_t(1) << row)) {
+      putU64(session.out, frame[row]);
+    }
+  }
+  session.sent = frame;
+  session.hasSent = true;
+}
+
+void Server::queueSnapshot(Session &session) {
+  if (session.out.size() > MAX_BACKLOG) {
+    return;
+  }
+  const Machine &machine = session.machine;
+  session.out += 'S';
+  putU32(session.out, session.frame);
+  putU16(session.out, machine.mem.getPC());
+  putU16(session.out, machine.indexReg);
+  for (size_t reg = 0; reg < 16; ++reg) {
+    session.out += static_cast<char>(machine.variableRegs.getReg(reg));
+  }
+  session.out += static_cast<char>(machine.timerDelay.getValue());
+  session.out += static_cast<char>(machine.timerSound.getValue());
+  session.out += static_cast<char>(machine.stack.size());
+  for (uint64_t row : machine.disp.getFrame()) {
+    putU64(session.out, row);
+  }
+}
+
+void Server::queueError(Session &session, const std::string &message) {
+  if (session.out.size() > MAX_BACKLOG) {
+    return;
+  }
+  session.out += 'E';
+  session.out += static_cast<char>(message.size());
+  session.out += message;
+}
+
+void Server::flush(Session &session) {
+  const int fd = session.fd;
+  size_t offset = 0;
+  while (offset < session.out.size()) {
+    const ssize_t n = send(fd, session.out.data() + offset,
+                           session.out.size() - offset, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        break;
+      }
+      closeSession(fd);
+      return;
+    }
+    offset += n;
+  }
+  session.out.erase(0, offset);
+
+  // Only ask for EPOLLOUT while there is a backlog.
+  const bool wantWrite = !session.out.empty();
+  if (wantWrite != session.wantWrite) {
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? uint32_t(EPOLLOUT) : 0u);
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+    session.wantWrite = wantWrite;
+  }
+}
+
+void Server::onWritable(Session &session) { flush(session); }
+
+void Server::closeSession(int fd) {
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  sessions.erase(fd);
+}
@@ -0,0 +1,102 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../cpu/cpu.hpp"
+#include "../cpu/shadow.hpp"
+
+// Hosts one emulator per client connection and multiplexes all of them on a
+// single thread with epoll. A 60 Hz timerfd drives emulation; after every
+// frame each session receives the rows of its display that changed since the
+// last frame it was sent.
+//
+// Client to server, one text command per line:
+//   KEYS <hex>     set the keypad bitmask (bit N = key N held)
+//   PAUSE          stop running frames
+//   RESUME         run at 60 Hz again
+//   STEP [n]       while paused, run n more frames (default 1, at most 600
+//                  queued); an error otherwise
+//   SNAPSHOT       request an 'S' message
+//   RESET          restart the ROM
+//
+// Server to client, binary, little-endian:
+//   'F' u32 frame, u32 changedRows, then one u64 per set bit of changedRows
+//       (ascending row order, column 0 in the most significant bit)
+//   'S' u32 frame, u16 pc, u16 i, u8 v[16], u8 dt, u8 st, u8 sp, u64 rows[32]
+//   'E' u8 length, message
+//
+// A session whose machine faults stops where it is and gets one 'E' message
+// describing the fault; RESET starts it over.
+//
+// A client that cannot keep up has frames, snapshots and errors dropped
+// rather than queued; the next delta is computed against what it actually
+// received.
+//
+// With a shadow interval, each session samples a frame every that many
+// instructions and replays it through the reference handlers. A divergence
+// is logged to stderr and checking stops for that session; the client is not
+// told.
+class Server {
+public:
+  explicit Server(std::vector<char> rom, int instructionsPerSecond = 700,
+                  uint64_t shadowInterval = 0);
+  ~Server();
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  bool listenTcp(int port);
+  bool listenUnix(const std::string &path);
+
+  // Serves clients until stop() is called from any thread.
+  void run();
+  void stop();
+
+private:
+  struct Session {
+    int fd = -1;
+    Machine machine;
+    IdleDetector idle;
+    std::unique_ptr<ShadowValidator> shadow;
+    components::Display::Frame sent = {};
+    bool hasSent = false;
+    bool paused = false;
+    bool wantWrite = false;
+    int pendingSteps = 0;
+    uint64_t frame = 0;
+    std::string in;
+    std::string out;
+  };
+
+  bool startListening(int fd);
+  void acceptClients();
+  void resetMachine(Session &session);
+  void onReadable(Session &session);
+  void onWritable(Session &session);
+  void handleCommand(Session &session, const std::string &line);
+  void tick();
+  void runSessionFrame(Session &session);
+  void queueDelta(Session &session);
+  void queueSnapshot(Session &session);
+  void queueError(Session &session, const std::string &message);
+  void flush(Session &session);
+  void closeSession(int fd);
+
+  std::vector<char> rom;
+  int instructionsPerSecond;
+  uint64_t shadowInterval;
+  int epollFd = -1;
+  int listenFd = -1;
+  int timerFd = -1;
+  int wakeFd = -1;
+  std::string unixPath;
+  std::atomic<bool> running{false};
+  std::unordered_map<int, std::unique_ptr<Session>> sessions;
+};
+
+#endif  // SERVER_HPP